@@ -1,8 +0,0 @@
-#version 330 core
-
-out vec4 fragColor;
-uniform vec4 uColor;
-
-void main() {
-    fragColor = uColor;
-}
\ No newline at end of file
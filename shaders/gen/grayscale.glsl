@@ -0,0 +1,5 @@
+// pointwise snippet, see src/fusion.hpp
+vec4 $apply(vec4 color) {
+    float gray = dot(color.rgb, vec3(0.299, 0.587, 0.114));
+    return vec4(vec3(gray), color.a);
+}
@@ -4,16 +4,25 @@ out vec4 fragColor;
 
 uniform sampler2D uTex;
 uniform mat3 uXform;
+// deferred transform of the input, see UVXform in src/utils.hpp
+uniform mat3 uInputXform = mat3(1.0);
+uniform mat3 uInputClip  = mat3(1.0);
+
+bool outside(vec2 uv) {
+  return uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0;
+}
 
 void main() {
   // apply affine in homogeneous coords
   vec3 p = uXform * vec3(vUV, 1.0);
   vec2 uv = p.xy;
+  vec2 src  = (uInputXform * vec3(uv, 1.0)).xy;
+  vec2 clip = (uInputClip * vec3(uv, 1.0)).xy;
 
   // transparent outside bounds (so you can layer/compose)
-  if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0) {
+  if (outside(uv) || outside(src) || outside(clip)) {
     fragColor = vec4(0.0);
   } else {
-    fragColor = texture(uTex, uv);
+    fragColor = texture(uTex, src);
   }
 }
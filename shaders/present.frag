@@ -4,7 +4,7 @@ out vec4 fragColor;
 
 uniform sampler2D uTex;
 uniform mat3 uXform;
-uniform vec2 uCanvasSize; // window framebuffer size in pixels
+uniform vec2 uCanvasSize; // output size in pixels
 uniform float uCheckerSize; // size of checker squares in pixels
 
 uniform vec3 uCheckerColor1   = vec3(0.137, 0.137, 0.137); // #232323
@@ -13,9 +13,20 @@ uniform vec3 uBackgroundColor = vec3(0.0, 0.0, 0.0);
 
 uniform bool uPremultiplied = false;
 
+// deferred transform of the output, see UVXform in src/utils.hpp
+uniform mat3 uSrcXform = mat3(1.0);
+uniform mat3 uSrcClip  = mat3(1.0);
+
+// while the output is refined progressively, only uRefinedRect of uTex is
+// final and the rest shows a coarse preview
+uniform sampler2D uPreview;
+uniform bool uHasPreview = false;
+uniform vec4 uRefinedRect; // x0, y0, x1, y1 in uv
+
 vec3 checker(vec2 uv) {
-  ivec2 texSize = textureSize(uTex, 0);
-  vec2 texel    = uv * vec2(texSize);
+  // canvas size rather than texture size, the texture may be rendered at a
+  // reduced scale
+  vec2 texel    = uv * uCanvasSize;
   vec2 cell     = floor(texel / uCheckerSize);
   float m       = mod(cell.x + cell.y, 2.0);
   return mix(uCheckerColor1, uCheckerColor2, m);
@@ -35,8 +46,18 @@ void main() {
 
   // Sample image (clamp outside so we get transparent)
   vec4 texel;
-  if (inCanvas) {
-    texel = texture(uTex, uv);
+  bool refined = (uv.x >= uRefinedRect.x && uv.x <= uRefinedRect.z &&
+                  uv.y >= uRefinedRect.y && uv.y <= uRefinedRect.w);
+  vec2 src  = (uSrcXform * vec3(uv, 1.0)).xy;
+  vec2 clip = (uSrcClip * vec3(uv, 1.0)).xy;
+  bool inSrc = (src.x >= 0.0 && src.x <= 1.0 && src.y >= 0.0 && src.y <= 1.0 &&
+                clip.x >= 0.0 && clip.x <= 1.0 && clip.y >= 0.0 && clip.y <= 1.0);
+  if (inCanvas && !inSrc) {
+    texel = vec4(0.0);
+  } else if (inCanvas && uHasPreview && !refined) {
+    texel = texture(uPreview, src);
+  } else if (inCanvas) {
+    texel = texture(uTex, src);
   } else {
     texel = vec4(0.0);
   }
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include "pool.hpp"
+#include "shader.hpp"
+
+// an op result detached from its op
+struct CachedResult {
+  FBO fbo;
+  int out_w = 0; // logical size, fbo may be smaller (see Op::render_scale)
+  int out_h = 0;
+  UVRect valid_roi = uvrect_empty();
+  float valid_scale = 0.0f;
+};
+
+// results that ops have moved away from, keyed by content hash
+// (see Op::hash_content). when an op comes back to a key that is still
+// cached, its texture is swapped back in instead of re-rendering.
+// entries are evicted least recently used first to stay under budget_bytes,
+// their targets going back to fbo_pool()
+struct ResultCache {
+  struct Entry {
+    uint64_t key;
+    CachedResult result;
+  };
+
+  std::list<Entry> lru; // most recently used first
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+  size_t budget_bytes = (size_t)512 << 20;
+  size_t used_bytes = 0;
+
+  // stats
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+
+  // takes ownership of result's fbo, which holds the result for key
+  void put(uint64_t key, CachedResult result) {
+    if (key == 0 || result.fbo.tex.id == 0) {
+      fbo_pool().release(result.fbo);
+      return;
+    }
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      // same content already cached, keep whichever copy covers more
+      CachedResult& cached = it->second->result;
+      bool better = result.valid_scale >= cached.valid_scale
+        && uvrect_contains(result.valid_roi, cached.valid_roi);
+      if (better) {
+        used_bytes -= cached.fbo.size_bytes();
+        fbo_pool().release(cached.fbo);
+        cached = result;
+        used_bytes += cached.fbo.size_bytes();
+      } else {
+        fbo_pool().release(result.fbo);
+      }
+      lru.splice(lru.begin(), lru, it->second);
+      trim(budget_bytes);
+      return;
+    }
+    used_bytes += result.fbo.size_bytes();
+    lru.push_front({ key, result });
+    entries[key] = lru.begin();
+    trim(budget_bytes);
+  }
+
+  // moves the result for key out of the cache, transferring ownership
+  bool take(uint64_t key, CachedResult& out) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+      misses++;
+      return false;
+    }
+    hits++;
+    out = it->second->result;
+    used_bytes -= out.fbo.size_bytes();
+    lru.erase(it->second);
+    entries.erase(it);
+    return true;
+  }
+
+  // hands out the least recently used entry of the given size for reuse as a
+  // render target, so steady edits don't allocate a new texture each frame.
+  // only done once the cache would have to evict to fit another result
+  FBO recycle(int w, int h) {
+    if (used_bytes + (size_t)w * h * 4 <= budget_bytes) {
+      return FBO{};
+    }
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+      if (it->result.fbo.tex.w == w && it->result.fbo.tex.h == h) {
+        FBO fbo = it->result.fbo;
+        used_bytes -= fbo.size_bytes();
+        entries.erase(it->key);
+        lru.erase(std::next(it).base());
+        evictions++;
+        return fbo;
+      }
+    }
+    return FBO{};
+  }
+
+  void trim(size_t bytes) {
+    while (used_bytes > bytes && !lru.empty()) {
+      Entry& entry = lru.back();
+      used_bytes -= entry.result.fbo.size_bytes();
+      fbo_pool().release(entry.result.fbo);
+      entries.erase(entry.key);
+      lru.pop_back();
+      evictions++;
+    }
+  }
+
+  void clear() { trim(0); }
+};
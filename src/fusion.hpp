@@ -0,0 +1,196 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader.hpp"
+
+// pointwise ops compute each output pixel only from their inputs' pixels at
+// the same uv, so a chain of them can run as one pass instead of a pass and
+// an intermediate texture per op. each one provides a glsl snippet defining
+//   vec4 $apply(vec4 input0, vec4 input1, ...)
+// along with its uniforms and helpers, every global name starting with $.
+// the snippets of a chain are pasted into one program with $ replaced by a
+// per-stage prefix, so names don't collide. vUV is available to snippets.
+// inputs are read through their UVXform, so deferred transforms upstream
+// are applied while sampling, and constant inputs come from a uniform
+// instead of a texture (see Op::fold_constant)
+
+// one snippet in a fused pass. each arg is either the sampler uTex<arg> if
+// arg >= 0, or the result of stage -arg - 1
+struct FusedStage {
+  const char* source_path;
+  std::vector<int> args;
+};
+
+static std::string fused_stage_prefix(int stage) {
+  return "s" + std::to_string(stage) + "_";
+}
+
+static const std::string& load_snippet(const char* path) {
+  static std::unordered_map<std::string, std::string> snippets;
+  auto it = snippets.find(path);
+  if (it == snippets.end()) {
+    it = snippets.emplace(path, load_source(path)).first;
+  }
+  return it->second;
+}
+
+static std::string generate_fused_source(const std::vector<FusedStage>& stages) {
+  int samplers = 0;
+  for (const FusedStage& stage : stages) {
+    for (int arg : stage.args) {
+      samplers = std::max(samplers, arg + 1);
+    }
+  }
+
+  std::string src = "#version 330 core\nin vec2 vUV;\nout vec4 fragColor;\n";
+  for (int i = 0; i < samplers; i++) {
+    std::string n = std::to_string(i);
+    src += "uniform sampler2D uTex" + n + ";\n";
+    src += "uniform mat3 uXform" + n + " = mat3(1.0);\n";
+    src += "uniform mat3 uClip" + n + " = mat3(1.0);\n";
+    src += "uniform bool uConst" + n + " = false;\n";
+    src += "uniform vec4 uConstValue" + n + ";\n";
+  }
+  src +=
+    "\n"
+    "vec4 sample_input(sampler2D tex, mat3 xform, mat3 clip, bool is_const, vec4 value) {\n"
+    "  vec2 uv = (xform * vec3(vUV, 1.0)).xy;\n"
+    "  vec2 c  = (clip * vec3(vUV, 1.0)).xy;\n"
+    "  if (any(lessThan(min(uv, c), vec2(0.0))) || any(greaterThan(max(uv, c), vec2(1.0)))) {\n"
+    "    return vec4(0.0);\n"
+    "  }\n"
+    "  return is_const ? value : texture(tex, uv);\n"
+    "}\n";
+  for (size_t s = 0; s < stages.size(); s++) {
+    std::string prefix = fused_stage_prefix((int)s);
+    src += "\n";
+    for (char c : load_snippet(stages[s].source_path)) {
+      if (c == '$') {
+        src += prefix;
+      } else {
+        src += c;
+      }
+    }
+  }
+
+  src += "\nvoid main() {\n";
+  for (size_t s = 0; s < stages.size(); s++) {
+    src += "  vec4 v" + std::to_string(s) + " = " + fused_stage_prefix((int)s) + "apply(";
+    for (size_t i = 0; i < stages[s].args.size(); i++) {
+      int arg = stages[s].args[i];
+      if (i > 0) src += ", ";
+      if (arg >= 0) {
+        std::string n = std::to_string(arg);
+        src += "sample_input(uTex" + n + ", uXform" + n + ", uClip" + n
+          + ", uConst" + n + ", uConstValue" + n + ")";
+      } else {
+        src += "v" + std::to_string(-arg - 1);
+      }
+    }
+    src += ");\n";
+  }
+  src += "  fragColor = v" + std::to_string(stages.size() - 1) + ";\n}\n";
+  return src;
+}
+
+// the source only depends on the stages' snippets and how their args are
+// wired, so that is what programs are registered by. every chain of the
+// same op types shares one program, and a plan recompile finds it without
+// generating its source
+static std::string fused_program_key(const std::vector<FusedStage>& stages) {
+  std::string key = "fused:";
+  for (const FusedStage& stage : stages) {
+    key += stage.source_path;
+    key += '(';
+    for (int arg : stage.args) {
+      key += std::to_string(arg);
+      key += ',';
+    }
+    key += ')';
+  }
+  return key;
+}
+
+static GLuint get_fused_program(const std::vector<FusedStage>& stages) {
+  std::string key = fused_program_key(stages);
+  GLuint program = program_registry().find(key);
+  if (program != 0) {
+    return program;
+  }
+  return program_registry().build(key, generate_fused_source(stages), stages.back().source_path);
+}
+
+// program running a single snippet, reading its inputs from uTex0, uTex1...
+static GLuint make_pointwise_program(const char* source_path, int input_count) {
+  FusedStage stage = { source_path, {} };
+  for (int i = 0; i < input_count; i++) {
+    stage.args.push_back(i);
+  }
+  return get_fused_program({ stage });
+}
+
+// uniforms of each input of a fused program, input i's at
+// i * FUSED_INPUT_UNIFORMS, see resolve_fused_inputs
+enum FusedInputUniform {
+  FUSED_CONST,
+  FUSED_CONST_VALUE,
+  FUSED_TEX,
+  FUSED_XFORM,
+  FUSED_CLIP,
+  FUSED_INPUT_UNIFORMS
+};
+
+static void resolve_fused_inputs(UniformSlots& slots, GLuint prog, size_t input_count) {
+  static const char* fields[FUSED_INPUT_UNIFORMS] = { "uConst", "uConstValue", "uTex", "uXform", "uClip" };
+  std::vector<std::string> names;
+  for (size_t i = 0; i < input_count; i++) {
+    for (const char* field : fields) {
+      names.push_back(field + std::to_string(i));
+    }
+  }
+  std::vector<const char*> name_ptrs;
+  for (const std::string& name : names) {
+    name_ptrs.push_back(name.c_str());
+  }
+  slots.resolve(prog, "", name_ptrs);
+}
+
+// a fused program's uniform slots: its inputs' and each stage's snippet's.
+// they only depend on the program, so steps sharing it share them
+struct FusedSlots {
+  UniformSlots inputs; // see resolve_fused_inputs
+  std::vector<UniformSlots> stages;
+};
+
+static FusedSlots& fused_slots(GLuint prog) {
+  static std::unordered_map<GLuint, FusedSlots> slots;
+  return slots[prog];
+}
+
+// binds textures to a fused program's samplers, uTex0 to unit 0 and so on,
+// along with the xform each is sampled through. inputs with a constant
+// (non-null) are read from it instead. slots are from resolve_fused_inputs
+static void bind_fused_inputs(
+  const UniformSlots& slots,
+  const std::vector<GLuint>& textures,
+  const std::vector<UVXform>& xforms,
+  const std::vector<const float*>& constants
+) {
+  for (size_t i = 0; i < textures.size(); i++) {
+    int base = (int)i * FUSED_INPUT_UNIFORMS;
+    UVXform xform = i < xforms.size() ? xforms[i] : UVXform{};
+    const float* constant = i < constants.size() ? constants[i] : nullptr;
+    gl_uniform1i(slots, base + FUSED_CONST, constant != nullptr);
+    if (constant) {
+      gl_uniform4fv(slots, base + FUSED_CONST_VALUE, constant);
+    }
+    gl_active_texture(GL_TEXTURE0 + (GLenum)i);
+    gl_bind_texture(GL_TEXTURE_2D, textures[i]);
+    gl_uniform1i(slots, base + FUSED_TEX, (int)i);
+    gl_uniform_matrix3fv(slots, base + FUSED_XFORM, GL_TRUE, xform.matrix.m);
+    gl_uniform_matrix3fv(slots, base + FUSED_CLIP, GL_TRUE, xform.clip.m);
+  }
+  gl_active_texture(GL_TEXTURE0);
+}
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// the gl calls that cost driver time, counted per frame and per op so the
+// profiler can show where the overhead goes. everything drawing through
+// the app's own code calls these instead of gl directly (imgui's backend
+// doesn't, and isn't counted).
+// the wrappers also remember the state they set and skip setting it again,
+// see GlStateCache
+struct GlCounters {
+  size_t draws = 0;
+  size_t blits = 0;
+  size_t program_switches = 0;
+  size_t texture_binds = 0;
+  size_t fbo_binds = 0;
+  size_t clears = 0;
+  size_t uniform_lookups = 0; // asking the driver, see UniformLayout
+  size_t uniform_uploads = 0;
+  size_t upload_bytes = 0;
+  size_t skipped_binds = 0; // state already set, see GlStateCache
+  size_t skipped_clears = 0; // clears made dead by a full-coverage draw
+  size_t skipped_uniforms = 0; // value the program already had
+
+  void add(const GlCounters& o) {
+    draws += o.draws;
+    blits += o.blits;
+    program_switches += o.program_switches;
+    texture_binds += o.texture_binds;
+    fbo_binds += o.fbo_binds;
+    clears += o.clears;
+    uniform_lookups += o.uniform_lookups;
+    uniform_uploads += o.uniform_uploads;
+    upload_bytes += o.upload_bytes;
+    skipped_binds += o.skipped_binds;
+    skipped_clears += o.skipped_clears;
+    skipped_uniforms += o.skipped_uniforms;
+  }
+};
+
+struct GlCallStats {
+  int op_id = -1; // op the calls are made for, -1 for none, see GlCallScope
+  std::unordered_map<int, GlCounters> frame; // by op id, this frame so far
+  std::unordered_map<int, GlCounters> last_frame;
+
+  GlCounters& current() { return frame[op_id]; }
+
+  // call once a frame
+  void end_frame() {
+    std::swap(frame, last_frame);
+    frame.clear();
+  }
+
+  GlCounters last_frame_total() const {
+    GlCounters total;
+    for (const auto& [id, counters] : last_frame) {
+      total.add(counters);
+    }
+    return total;
+  }
+};
+
+static GlCallStats& gl_call_stats() {
+  static GlCallStats stats;
+  return stats;
+}
+
+// counts the calls made while it lives towards op_id
+struct GlCallScope {
+  int prev;
+  explicit GlCallScope(int op_id) : prev(gl_call_stats().op_id) { gl_call_stats().op_id = op_id; }
+  ~GlCallScope() { gl_call_stats().op_id = prev; }
+  GlCallScope(const GlCallScope&) = delete;
+  GlCallScope& operator=(const GlCallScope&) = delete;
+};
+
+// the state the wrappers below last set. UNKNOWN means it may have changed
+// behind their back, so the next set goes through. imgui's backend draws
+// with its own calls, so the state is reset around it (see gl_state_reset).
+// a pass clearing its target (gl_clear_lazy) doesn't clear right away:
+// passes draw a full-coverage triangle strip without blending
+// (gl_draw_fullscreen), which overwrites every pixel the clear would have
+// touched, so the clear is dropped. anything else that could observe the
+// cleared pixels, or changes what the clear would affect, performs it first
+struct GlStateCache {
+  static constexpr GLuint UNKNOWN = ~0u;
+  static constexpr int MAX_UNITS = 16;
+
+  GLuint program = UNKNOWN;
+  GLuint active_unit = UNKNOWN; // index, not GL_TEXTUREi
+  GLuint textures[MAX_UNITS]; // GL_TEXTURE_2D per unit
+  GLuint draw_fbo = UNKNOWN;
+  GLuint read_fbo = UNKNOWN;
+  GLint viewport[4] = { -1, -1, -1, -1 };
+  int scissor_test = -1; // -1 unknown
+  GLint scissor[4] = { -1, -1, -1, -1 };
+  float clear_color[4] = { -1.0f, -1.0f, -1.0f, -1.0f };
+  GLbitfield pending_clear = 0;
+
+  GlStateCache() { forget(); }
+
+  void forget() {
+    program = UNKNOWN;
+    active_unit = UNKNOWN;
+    for (GLuint& texture : textures) texture = UNKNOWN;
+    draw_fbo = UNKNOWN;
+    read_fbo = UNKNOWN;
+    for (int i = 0; i < 4; i++) {
+      viewport[i] = -1;
+      scissor[i] = -1;
+      clear_color[i] = -1.0f;
+    }
+    scissor_test = -1;
+  }
+};
+
+static GlStateCache& gl_state() {
+  static GlStateCache state;
+  return state;
+}
+
+// performs a clear waiting for a full-coverage draw, see GlStateCache
+static void gl_flush_clear() {
+  GlStateCache& state = gl_state();
+  if (state.pending_clear != 0) {
+    gl_call_stats().current().clears++;
+    glClear(state.pending_clear);
+    state.pending_clear = 0;
+  }
+}
+
+// call after anything else has made gl calls, and before the frame ends
+static void gl_state_reset() {
+  gl_flush_clear();
+  gl_state().forget();
+}
+
+static bool gl_skip(bool same) {
+  if (same) {
+    gl_call_stats().current().skipped_binds++;
+  }
+  return same;
+}
+
+static void gl_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+  gl_flush_clear();
+  gl_call_stats().current().draws++;
+  glDrawArrays(mode, first, count);
+}
+
+// draws the full-screen strip of fullscreen.vert, without blending
+static void gl_draw_fullscreen() {
+  GlStateCache& state = gl_state();
+  if (state.pending_clear != 0) {
+    gl_call_stats().current().skipped_clears++;
+    state.pending_clear = 0;
+  }
+  gl_call_stats().current().draws++;
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+static void gl_blit_framebuffer(
+  GLint sx0, GLint sy0, GLint sx1, GLint sy1,
+  GLint dx0, GLint dy0, GLint dx1, GLint dy1,
+  GLbitfield mask, GLenum filter
+) {
+  gl_flush_clear();
+  gl_call_stats().current().blits++;
+  glBlitFramebuffer(sx0, sy0, sx1, sy1, dx0, dy0, dx1, dy1, mask, filter);
+}
+
+static void gl_use_program(GLuint program) {
+  GlStateCache& state = gl_state();
+  if (gl_skip(state.program == program)) {
+    return;
+  }
+  gl_call_stats().current().program_switches++;
+  glUseProgram(program);
+  state.program = program;
+}
+
+static void gl_active_texture(GLenum unit) {
+  GlStateCache& state = gl_state();
+  if (gl_skip(state.active_unit == unit - GL_TEXTURE0)) {
+    return;
+  }
+  glActiveTexture(unit);
+  state.active_unit = unit - GL_TEXTURE0;
+}
+
+static void gl_bind_texture(GLenum target, GLuint texture) {
+  GlStateCache& state = gl_state();
+  bool cached = target == GL_TEXTURE_2D && state.active_unit < GlStateCache::MAX_UNITS;
+  if (gl_skip(cached && state.textures[state.active_unit] == texture)) {
+    return;
+  }
+  gl_call_stats().current().texture_binds++;
+  glBindTexture(target, texture);
+  if (cached) {
+    state.textures[state.active_unit] = texture;
+  }
+}
+
+static void gl_bind_framebuffer(GLenum target, GLuint framebuffer) {
+  GlStateCache& state = gl_state();
+  bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+  bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+  if (gl_skip((!draw || state.draw_fbo == framebuffer) && (!read || state.read_fbo == framebuffer))) {
+    return;
+  }
+  if (draw) {
+    gl_flush_clear();
+  }
+  gl_call_stats().current().fbo_binds++;
+  glBindFramebuffer(target, framebuffer);
+  if (draw) state.draw_fbo = framebuffer;
+  if (read) state.read_fbo = framebuffer;
+}
+
+static void gl_viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+  GlStateCache& state = gl_state();
+  GLint* v = state.viewport;
+  if (gl_skip(v[0] == x && v[1] == y && v[2] == w && v[3] == h)) {
+    return;
+  }
+  glViewport(x, y, w, h);
+  v[0] = x; v[1] = y; v[2] = w; v[3] = h;
+}
+
+static void gl_scissor_test(bool enabled) {
+  GlStateCache& state = gl_state();
+  if (gl_skip(state.scissor_test == (int)enabled)) {
+    return;
+  }
+  gl_flush_clear();
+  if (enabled) glEnable(GL_SCISSOR_TEST);
+  else glDisable(GL_SCISSOR_TEST);
+  state.scissor_test = enabled;
+}
+
+static void gl_scissor(GLint x, GLint y, GLsizei w, GLsizei h) {
+  GlStateCache& state = gl_state();
+  GLint* s = state.scissor;
+  if (gl_skip(s[0] == x && s[1] == y && s[2] == w && s[3] == h)) {
+    return;
+  }
+  gl_flush_clear();
+  glScissor(x, y, w, h);
+  s[0] = x; s[1] = y; s[2] = w; s[3] = h;
+}
+
+static void gl_clear_color(float r, float g, float b, float a) {
+  GlStateCache& state = gl_state();
+  float* c = state.clear_color;
+  if (gl_skip(c[0] == r && c[1] == g && c[2] == b && c[3] == a)) {
+    return;
+  }
+  gl_flush_clear();
+  glClearColor(r, g, b, a);
+  c[0] = r; c[1] = g; c[2] = b; c[3] = a;
+}
+
+static void gl_clear(GLbitfield mask) {
+  gl_state().pending_clear = 0;
+  gl_call_stats().current().clears++;
+  glClear(mask);
+}
+
+// clears unless a full-coverage draw follows, see GlStateCache
+static void gl_clear_lazy(GLbitfield mask) {
+  gl_state().pending_clear |= mask;
+}
+
+// deleting an object unbinds it, and its name may come back for a new one
+static void gl_delete_texture(GLuint texture) {
+  GlStateCache& state = gl_state();
+  for (GLuint& bound : state.textures) {
+    if (bound == texture) bound = 0;
+  }
+  glDeleteTextures(1, &texture);
+}
+
+static void gl_delete_framebuffer(GLuint framebuffer) {
+  GlStateCache& state = gl_state();
+  if (state.draw_fbo == framebuffer) {
+    gl_flush_clear();
+    state.draw_fbo = 0;
+  }
+  if (state.read_fbo == framebuffer) state.read_fbo = 0;
+  glDeleteFramebuffers(1, &framebuffer);
+}
+
+// a program's uniforms, asked of the driver once when it is first used,
+// and the values it was last given. a program keeps its uniforms' values
+// while other programs are in use, so setting an unchanged one is skipped;
+// ops whose parameters didn't change cost no uniform calls at all
+struct UniformLayout {
+  struct Value {
+    bool known = false;
+    unsigned char bytes[40]; // up to a mat3 and its transpose flag
+  };
+
+  std::unordered_map<std::string, GLint> locations; // by name, arrays without [0]
+  std::vector<Value> values; // by location
+};
+
+static std::unordered_map<GLuint, UniformLayout>& uniform_layouts() {
+  static std::unordered_map<GLuint, UniformLayout> layouts;
+  return layouts;
+}
+
+static UniformLayout& uniform_layout(GLuint program) {
+  auto [it, added] = uniform_layouts().try_emplace(program);
+  UniformLayout& layout = it->second;
+  if (!added) {
+    return layout;
+  }
+  GLint count = 0;
+  GLint max_length = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  std::vector<char> name(std::max(max_length, 1));
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+    std::string key(name.data(), length);
+    gl_call_stats().current().uniform_lookups++;
+    GLint location = glGetUniformLocation(program, key.c_str());
+    if (location < 0) {
+      continue; // in a uniform block
+    }
+    if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+      key.resize(key.size() - 3);
+    }
+    layout.locations[key] = location;
+    if ((size_t)location + size > layout.values.size()) {
+      layout.values.resize((size_t)location + size);
+    }
+  }
+  return layout;
+}
+
+// locations of a fixed list of uniforms of one program, looked up by name
+// once, when the program or the plan step using it is set up. uploads then
+// go by index into the list, with no strings involved. a program's layout
+// lives as long as the program, see gl_delete_program
+struct UniformSlots {
+  GLuint program = 0;
+  UniformLayout* layout = nullptr;
+  std::vector<GLint> locations; // -1 for uniforms the program doesn't use
+
+  // looks up prefix + each of names in program
+  void resolve(GLuint prog, const std::string& prefix, const std::vector<const char*>& names) {
+    program = prog;
+    layout = prog != 0 ? &uniform_layout(prog) : nullptr;
+    locations.assign(names.size(), -1);
+    if (!layout) {
+      return;
+    }
+    std::string name = prefix;
+    for (size_t i = 0; i < names.size(); i++) {
+      name.resize(prefix.size());
+      name += names[i];
+      auto it = layout->locations.find(name);
+      locations[i] = it == layout->locations.end() ? -1 : it->second;
+    }
+  }
+
+  // location to upload size bytes of data to for uniform slot, or -1 if the
+  // program, which must be in use, already has them there
+  GLint target(int slot, const void* data, size_t size) const {
+    GLint location = slot < (int)locations.size() ? locations[slot] : -1;
+    if (location < 0) {
+      return -1;
+    }
+    UniformLayout::Value& value = layout->values[location];
+    if (value.known && std::memcmp(value.bytes, data, size) == 0) {
+      gl_call_stats().current().skipped_uniforms++;
+      return -1;
+    }
+    value.known = true;
+    std::memcpy(value.bytes, data, size);
+    gl_call_stats().current().uniform_uploads++;
+    return location;
+  }
+};
+
+static void gl_uniform1i(const UniformSlots& u, int slot, GLint x) {
+  GLint location = u.target(slot, &x, sizeof(x));
+  if (location >= 0) glUniform1i(location, x);
+}
+
+static void gl_uniform1f(const UniformSlots& u, int slot, float x) {
+  GLint location = u.target(slot, &x, sizeof(x));
+  if (location >= 0) glUniform1f(location, x);
+}
+
+static void gl_uniform2f(const UniformSlots& u, int slot, float x, float y) {
+  const float v[2] = { x, y };
+  GLint location = u.target(slot, v, sizeof(v));
+  if (location >= 0) glUniform2fv(location, 1, v);
+}
+
+static void gl_uniform3f(const UniformSlots& u, int slot, float x, float y, float z) {
+  const float v[3] = { x, y, z };
+  GLint location = u.target(slot, v, sizeof(v));
+  if (location >= 0) glUniform3fv(location, 1, v);
+}
+
+static void gl_uniform4fv(const UniformSlots& u, int slot, const float* v) {
+  GLint location = u.target(slot, v, 4 * sizeof(float));
+  if (location >= 0) glUniform4fv(location, 1, v);
+}
+
+static void gl_uniform4f(const UniformSlots& u, int slot, float x, float y, float z, float w) {
+  const float v[4] = { x, y, z, w };
+  gl_uniform4fv(u, slot, v);
+}
+
+static void gl_uniform_matrix3fv(const UniformSlots& u, int slot, GLboolean transpose, const float* m) {
+  float v[10];
+  std::memcpy(v, m, 9 * sizeof(float));
+  v[9] = transpose;
+  GLint location = u.target(slot, v, sizeof(v));
+  if (location >= 0) glUniformMatrix3fv(location, 1, transpose, m);
+}
+
+// a program in use lives on until another is used, so its name can't
+// come back while the cache still has it
+static void gl_delete_program(GLuint program) {
+  uniform_layouts().erase(program);
+  glDeleteProgram(program);
+}
+
+static void gl_tex_image_2d(
+  GLenum target, GLint level, GLint internal_format, GLsizei w, GLsizei h,
+  GLint border, GLenum format, GLenum type, const void* pixels
+) {
+  if (pixels) {
+    size_t channels = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+    size_t channel_bytes = type == GL_FLOAT ? 4 : type == GL_HALF_FLOAT ? 2 : 1;
+    gl_call_stats().current().upload_bytes += (size_t)w * h * channels * channel_bytes;
+  }
+  glTexImage2D(target, level, internal_format, w, h, border, format, type, pixels);
+}
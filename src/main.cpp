@@ -21,14 +21,21 @@ extern "C" {
 #include "imnodes.h"
 
 #include <stdio.h>
+#include <climits>
 #include <format>
 #include <memory>
+#include <queue>
+#include <unordered_map>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include "nodes.hpp"
+#include "cache.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+#include "slot_map.hpp"
 #include "shader.hpp"
 #include "style.hpp"
 #include "utils.hpp"
@@ -44,18 +51,153 @@ struct Link {
   int id;
   int start_attr; // output attribute id
   int end_attr;   // input attribute id
+  int from_id;    // producing op
+  int to_id;      // consuming op
+  int input_idx;  // input index on the consuming op
+  int output_pos; // position in the producing op's output_links
+};
+
+// what an ImNodes attribute id refers to
+// index is the input index, or ATTR_OUTPUT for the op's output
+constexpr int ATTR_OUTPUT = -1;
+struct AttrRef {
+  int op_id;
+  int index;
+};
+
+// each op owns a contiguous block of attribute ids starting at attr_base:
+// one per input followed by the output. encoding is an add and decoding is
+// an array lookup, so the node drawing loop does no hashing, and freed
+// blocks are reused, so ids stay dense however long the session runs
+inline int input_attr_id(const Op& op, int input_idx) {
+  return op.attr_base + input_idx;
+}
+
+inline int output_attr_id(const Op& op) {
+  return op.attr_base + (int)op.input_ids.size();
+}
+
+// what a step does when the plan runs, see State::prepare_step
+enum class StepKind {
+  Render, // renders into its op's layer_fbo
+  Alias, // bypassed, passes its first input on
+  Constant, // folded on the cpu, see State::fold_step
+  Deferred, // transform applied by its consumers
+  Fused // evaluated inside a later step's pass
+};
+
+// one op in a compiled execution plan
+struct PlanStep {
+  Op* op = nullptr;
+  std::vector<int> input_steps; // plan index of each input, -1 if unconnected
+  std::vector<GLuint> input_textures; // filled from input_steps before each run
+
+  // constant folding, see State::fold_step
+  bool constant = false; // output is constant, decided by the graph alone
+  bool needs_texture = false; // a consumer reads the constant as a texture
+
+  // deferred transforms, see State::prepare_step
+  bool can_defer = false; // the op resamples its input and all consumers can sample deferred
+
+  // set each run, see State::run_plan
+  StepKind kind = StepKind::Render;
+  bool refill = false; // the constant texture is out of date, see fold_step
+  bool needed = false; // something reads the output this run
+  bool renders = false;
+  int last_use = -1; // last step reading the output, see State::plan_demand
+  int release_next = -1; // next step released after the same step
+
+  // pointwise fusion, see State::fuse_plan
+  int fused_into = -1; // step whose pass evaluates this op, -1 if none
+  std::vector<FusedStage> fused_stages; // stages of this step's pass, if it fuses ops
+  std::vector<Op*> fused_ops; // op of each stage
+  std::vector<int> fused_input_steps; // plan step sampled by each uTex<n>, -1 if none
+  std::vector<GLuint> fused_input_textures;
+  std::vector<UVXform> fused_input_xforms;
+  std::vector<const float*> fused_input_constants;
+  GLuint fused_prog = 0;
+  const FusedSlots* fused_uniforms = nullptr;
 };
 
 struct State {
   FBO present_fbo;
   int present_w = 512;
   int present_h = 512;
-  int next_op_id = 0;
-  std::vector<std::unique_ptr<Op>> ops;
+  // op and link ids are slot handles: a deleted op's or link's id never
+  // resolves again, even once its slot holds something else
+  SlotMap<std::unique_ptr<Op>> ops;
   int output_node_id = -1;
 
-  std::vector<Link> links;
-  int next_link_id = 0;
+  SlotMap<Link> links;
+
+  // attribute id -> owner, see input_attr_id
+  std::vector<AttrRef> attrs;
+  std::unordered_map<int, std::vector<int>> free_attr_blocks; // block size -> bases
+
+  // flat, topologically sorted list of ops reachable from the output node,
+  // built by compile_plan when the output node changes and patched by
+  // patch_plan after edits
+  std::vector<PlanStep> plan;
+  int plan_root_id = -1;
+  bool plan_dirty = true; // compile the plan anew
+  // counted by prepare_plan
+  int plan_fused_ops = 0; // ops evaluated inside another op's pass
+  int plan_deferred_ops = 0; // transforms applied by their consumers' sampling
+  int plan_constant_ops = 0; // ops folded on the cpu
+
+  // edits since the plan was compiled or patched, see patch_plan
+  std::vector<int> plan_touched; // ids of ops whose steps need another look, see touch
+  std::vector<int> plan_holes; // steps of deleted ops
+  int plan_ord_lo = INT_MAX; // range of topo_ords reassigned, see topo_insert_edge
+  int plan_ord_hi = INT_MIN;
+  UVXform present_xform; // out_xform of the output, applied by the present pass
+
+  // visible part of the output, see set_view
+  UVRect view_request;
+  float view_scale = 1.0f;
+
+  // progressive evaluation, see eval. pixel_budget is the number of op
+  // pixels rendered per frame, tuned from frame times by tune_budget
+  bool progressive = true;
+  double pixel_budget = 16e6;
+  double budget_used = 0.0;
+  bool budget_limited = false;
+  UVRect refine_roi = uvrect_empty(); // request being refined
+  float refine_scale = 0.0f;
+  float refine_y = 0.0f; // rows of refine_roi below this are final
+  FBO preview_fbo; // coarse render of the output, shown until refinement is done
+  UVRect preview_roi = uvrect_empty();
+
+  // while a parameter is being dragged the graph renders at proxy_scale,
+  // then at full resolution once it's released (1 disables proxies)
+  float proxy_scale = 0.25f;
+  bool dragging = false;
+
+  // keep only the output's and pinned ops' results, see plan_demand
+  bool low_vram = false;
+  std::vector<int> release_heads; // per step, first step released after it
+  std::unordered_map<uint64_t, std::vector<FBO>> plan_free; // see allocate_targets
+  std::vector<UVRect> input_windows; // scratch for prepare_step
+
+  // results ops have moved away from, for reuse when they come back to them
+  ResultCache cache;
+  GpuTimers gpu_timers; // per op, see execute_step
+
+  // incremental topological order over all ops, see topo_insert_edge
+  int next_topo_ord = 0;
+  std::vector<Op*> topo_forward;
+  std::vector<Op*> topo_backward;
+  std::vector<int> topo_ords;
+
+  // scratch for graph walks and for compile_plan and patch_plan
+  uint32_t walk_mark = 0;
+  std::vector<Op*> walk_stack;
+  std::vector<Op*> plan_order;
+  std::vector<Op*> patch_ops;
+  std::vector<int> patch_steps;
+  std::vector<int> patch_remap;
+  std::vector<int> patch_regroup;
+  std::vector<int> patch_chain;
 
   float zoom_factor   = 1.0f;
   float last_mouse_x  = 0.0f;
@@ -70,7 +212,6 @@ struct State {
     ops.reserve(16);
 
     set_present_fbo_size(present_w, present_h);
-    present_fbo.tex.set_filter_mode(GL_NEAREST);
 
     // init vao & fbos
     GLuint vao = 0;
@@ -81,105 +222,1685 @@ struct State {
   void set_present_fbo_size(int w, int h) {
     present_w = w;
     present_h = h;
-    present_fbo.create(w, h);
+    fbo_pool().ensure(present_fbo, w, h);
+    present_fbo.tex.set_filter_mode(GL_NEAREST);
+  }
+
+  int register_op(std::unique_ptr<Op> op) {
+    if (ops.full()) {
+      LOG_ERROR("Out of op ids, dropping %s", op->get_type_name());
+      op.reset();
+      gpu_resources().adopt(GpuResources::OWNER_GONE);
+      return -1;
+    }
+    Op* raw = op.get();
+    raw->id = (int)ops.insert(std::move(op));
+    raw->topo_ord = next_topo_ord++;
+    raw->input_links.assign(raw->input_ids.size(), -1);
+    raw->attr_base = alloc_attrs(raw->id, (int)raw->input_ids.size() + 1);
+    gpu_resources().adopt(raw->id);
+    if (raw->get_type_name() == std::string("const/output")) {
+      output_node_id = raw->id;
+    }
+    return raw->id;
+  }
+
+  Op* get_op_by_id(int id) {
+    if (id < 0) return nullptr;
+    std::unique_ptr<Op>* op = ops.get((SlotHandle)id);
+    return op ? op->get() : nullptr;
+  }
+
+  int alloc_attrs(int op_id, int count) {
+    int base;
+    std::vector<int>& free_list = free_attr_blocks[count];
+    if (!free_list.empty()) {
+      base = free_list.back();
+      free_list.pop_back();
+    } else {
+      base = (int)attrs.size();
+      attrs.resize(attrs.size() + count);
+    }
+    for (int i = 0; i < count; i++) {
+      attrs[base + i] = { op_id, i == count - 1 ? ATTR_OUTPUT : i };
+    }
+    return base;
+  }
+
+  void free_attrs(int base, int count) {
+    for (int i = 0; i < count; i++) {
+      attrs[base + i] = { -1, ATTR_OUTPUT };
+    }
+    free_attr_blocks[count].push_back(base);
+  }
+
+  const AttrRef* get_attr(int attr_id) {
+    if (attr_id < 0 || static_cast<size_t>(attr_id) >= attrs.size() || attrs[attr_id].op_id < 0) {
+      return nullptr;
+    }
+    return &attrs[attr_id];
+  }
+
+  Link* get_link_by_id(int id) {
+    if (id < 0) return nullptr;
+    return links.get((SlotHandle)id);
   }
 
-  void create_link(int start_attr, int end_attr) {
+  // consumer on the other end of one of an op's output links
+  Op* get_link_consumer(int link_id) {
+    Link* link = get_link_by_id(link_id);
+    return link ? get_op_by_id(link->to_id) : nullptr;
+  }
+
+  // O(degree) plus the ops leaving the plan: only the op's own links are
+  // touched
+  void unregister_op(int id) {
+    gpu_timers.forget(id);
+    if (output_node_id == id) {
+      output_node_id = -1;
+    }
+
+    Op* op = get_op_by_id(id);
+    if (!op) {
+      return;
+    }
+    if (id == plan_root_id) {
+      plan_dirty = true;
+    }
+    if (op->plan_index >= 0) {
+      // the group's ops keep pointers to it
+      dissolve_group(op->plan_index);
+    }
+    for (size_t i = 0; i < op->input_links.size(); i++) {
+      clear_input(id, (int)i);
+    }
+    while (!op->output_links.empty()) {
+      remove_link(op->output_links.back());
+    }
+    if (op->plan_index >= 0) {
+      // dropped by patch_plan
+      plan[op->plan_index].op = nullptr;
+      plan_holes.push_back(op->plan_index);
+    }
+
+    cache.put(op->result_key, detach_result(op));
+    free_attrs(op->attr_base, (int)op->input_ids.size() + 1);
+    ops.erase((SlotHandle)id);
+    gpu_resources().orphan(id);
+  }
+
+  // connects the output of from_id to input index input_idx of op_id,
+  // replacing any previous connection. returns the new link id, or -1 with
+  // the graph untouched if the edge would create a cycle
+  int set_input(int op_id, int input_idx, int from_id, int start_attr, int end_attr) {
+    Op* op = get_op_by_id(op_id);
+    Op* from = get_op_by_id(from_id);
+    if (!op || !from || static_cast<size_t>(input_idx) >= op->input_ids.size() || links.full()) {
+      return -1;
+    }
+    if (!topo_insert_edge(from, op)) {
+      return -1;
+    }
+    // before the old link goes, so an op reconnected to the same input
+    // doesn't leave the plan on the way
+    if (op->plan_refs > 0) {
+      plan_ref(from);
+    }
+    clear_input(op_id, input_idx);
+
     Link link;
-    link.id = next_link_id++;
     link.start_attr = start_attr;
     link.end_attr = end_attr;
-    links.push_back(link);
+    link.from_id = from_id;
+    link.to_id = op_id;
+    link.input_idx = input_idx;
+    link.output_pos = (int)from->output_links.size();
+    link.id = (int)links.insert(link);
+    links.get((SlotHandle)link.id)->id = link.id;
+
+    from->output_links.push_back(link.id);
+    op->input_links[input_idx] = link.id;
+    op->input_ids[input_idx] = from_id;
+    touch(from);
+    touch(op);
+    invalidate(op_id);
+    return link.id;
+  }
+
+  void clear_input(int op_id, int input_idx) {
+    Op* op = get_op_by_id(op_id);
+    if (!op || static_cast<size_t>(input_idx) >= op->input_links.size()) {
+      return;
+    }
+    if (op->input_links[input_idx] != -1) {
+      remove_link(op->input_links[input_idx]);
+    }
   }
 
   void remove_link(int link_id) {
-    links.erase(
-      std::remove_if(
-        links.begin(),
-        links.end(),
-        [link_id](const Link& link) { return link.id == link_id; }
-      ),
-      links.end()
-    );
+    Link* link = get_link_by_id(link_id);
+    if (!link) {
+      return;
+    }
+
+    // swap-remove from the producer's output list
+    Op* from = get_op_by_id(link->from_id);
+    if (from) {
+      int moved_id = from->output_links.back();
+      from->output_links[link->output_pos] = moved_id;
+      from->output_links.pop_back();
+      if (moved_id != link_id) {
+        get_link_by_id(moved_id)->output_pos = link->output_pos;
+      }
+      touch(from);
+    }
+    int to_id = link->to_id;
+    Op* to = get_op_by_id(to_id);
+    if (to) {
+      to->input_links[link->input_idx] = -1;
+      to->input_ids[link->input_idx] = -1;
+      touch(to);
+      if (from && to->plan_refs > 0) {
+        plan_unref(from);
+      }
+    }
+
+    links.erase((SlotHandle)link_id);
+    invalidate(to_id);
   }
 
-  void register_op(std::unique_ptr<Op> op) {
-    op->id = next_op_id++;
-    if (op->get_type_name() == std::string("const/output")) {
-      output_node_id = op->id;
+  // pearce-kelly dynamic topological order: adding from -> to only reorders
+  // the ops whose topo_ord lies between the two endpoints, so the cost
+  // depends on the affected region rather than the size of the graph.
+  // returns false if to already reaches from, i.e. the edge closes a cycle
+  bool topo_insert_edge(Op* from, Op* to) {
+    if (from == to) {
+      return false;
+    }
+    int lower = to->topo_ord;
+    int upper = from->topo_ord;
+    if (upper < lower) {
+      return true; // already in order
+    }
+
+    uint32_t mark = ++walk_mark;
+
+    // forward: everything reachable from `to` that is ordered before `from`
+    topo_forward.clear();
+    walk_stack.assign(1, to);
+    to->visit_mark = mark;
+    while (!walk_stack.empty()) {
+      Op* cur = walk_stack.back();
+      walk_stack.pop_back();
+      topo_forward.push_back(cur);
+      for (int link_id : cur->output_links) {
+        Op* consumer = get_link_consumer(link_id);
+        if (!consumer) {
+          continue;
+        }
+        if (consumer == from) {
+          return false;
+        }
+        if (consumer->visit_mark != mark && consumer->topo_ord < upper) {
+          consumer->visit_mark = mark;
+          walk_stack.push_back(consumer);
+        }
+      }
+    }
+
+    // backward: everything reaching `from` that is ordered after `to`
+    topo_backward.clear();
+    walk_stack.assign(1, from);
+    from->visit_mark = mark;
+    while (!walk_stack.empty()) {
+      Op* cur = walk_stack.back();
+      walk_stack.pop_back();
+      topo_backward.push_back(cur);
+      for (int input_id : cur->input_ids) {
+        Op* input = get_op_by_id(input_id);
+        if (input && input->visit_mark != mark && input->topo_ord > lower) {
+          input->visit_mark = mark;
+          walk_stack.push_back(input);
+        }
+      }
     }
-    ops.push_back(std::move(op));
+
+    // hand the affected ords back out, backward set first
+    auto by_ord = [](const Op* a, const Op* b) { return a->topo_ord < b->topo_ord; };
+    std::sort(topo_forward.begin(), topo_forward.end(), by_ord);
+    std::sort(topo_backward.begin(), topo_backward.end(), by_ord);
+
+    topo_ords.clear();
+    for (Op* op : topo_backward) topo_ords.push_back(op->topo_ord);
+    for (Op* op : topo_forward)  topo_ords.push_back(op->topo_ord);
+    std::sort(topo_ords.begin(), topo_ords.end());
+
+    size_t n = 0;
+    for (Op* op : topo_backward) op->topo_ord = topo_ords[n++];
+    for (Op* op : topo_forward)  op->topo_ord = topo_ords[n++];
+
+    // the plan's steps in this range are re-sorted by patch_plan
+    plan_ord_lo = std::min(plan_ord_lo, lower);
+    plan_ord_hi = std::max(plan_ord_hi, upper);
+    return true;
   }
 
-  std::unique_ptr<Op>& get_op_by_id(int id) {
-    for (auto& op : ops) {
-      if (op->id == id) {
-        return op;
+  // notes that an op's step needs another look when the plan is patched:
+  // its inputs, its consumers, its flags or whether it is in the plan changed
+  void touch(Op* op) {
+    if (!op->plan_touched) {
+      op->plan_touched = true;
+      plan_touched.push_back(op->id);
+    }
+  }
+
+  // an op is in the plan while plan_refs > 0: one for being the root and
+  // one per output link into an op in the plan. the graph is acyclic, so the
+  // count is exact, and an edit only walks the ops entering or leaving
+  void plan_ref(Op* op) {
+    walk_stack.assign(1, op);
+    while (!walk_stack.empty()) {
+      Op* cur = walk_stack.back();
+      walk_stack.pop_back();
+      touch(cur);
+      if (cur->plan_refs++ > 0) {
+        continue;
+      }
+      for (int input_id : cur->input_ids) {
+        if (Op* input = get_op_by_id(input_id)) {
+          walk_stack.push_back(input);
+        }
       }
     }
-    static std::unique_ptr<Op> null_op = nullptr;
-    return null_op;
   }
 
-  void unregister_op(int id) {
-    if (output_node_id == id) {
-      output_node_id = -1;
+  void plan_unref(Op* op) {
+    walk_stack.assign(1, op);
+    while (!walk_stack.empty()) {
+      Op* cur = walk_stack.back();
+      walk_stack.pop_back();
+      touch(cur);
+      if (--cur->plan_refs > 0) {
+        continue;
+      }
+      for (int input_id : cur->input_ids) {
+        if (Op* input = get_op_by_id(input_id)) {
+          walk_stack.push_back(input);
+        }
+      }
     }
+  }
 
-    ops.erase(
-      std::remove_if(
-        ops.begin(),
-        ops.end(),
-        [id](const std::unique_ptr<Op>& op) { return op->id == id; }
-      ),
-      ops.end()
+  void render(Op* op, const std::vector<GLuint>& input_textures) {
+    op->apply(input_textures);
+  }
+
+  // renders a step that fuses several pointwise ops into one pass
+  void render_fused(PlanStep& step) {
+    Op* op = step.op;
+    op->check_targets();
+    op->begin_pass(op->layer_fbo);
+
+    step.fused_input_textures.resize(step.fused_input_steps.size());
+    step.fused_input_xforms.resize(step.fused_input_steps.size());
+    step.fused_input_constants.resize(step.fused_input_steps.size());
+    for (size_t i = 0; i < step.fused_input_steps.size(); i++) {
+      int input_step = step.fused_input_steps[i];
+      Op* input = input_step < 0 ? nullptr : plan[input_step].op;
+      step.fused_input_textures[i] = input ? input->out_tex : 0;
+      step.fused_input_xforms[i] = input ? input->out_xform : UVXform{};
+      step.fused_input_constants[i] = input && input->is_constant ? input->constant_value : nullptr;
+    }
+
+    gl_use_program(step.fused_prog);
+    bind_fused_inputs(
+      step.fused_uniforms->inputs,
+      step.fused_input_textures,
+      step.fused_input_xforms,
+      step.fused_input_constants
     );
+    for (size_t i = 0; i < step.fused_ops.size(); i++) {
+      step.fused_ops[i]->set_pointwise_uniforms(step.fused_uniforms->stages[i]);
+    }
+    gl_draw_fullscreen();
   }
 
-  void render(Op* op, const std::vector<GLuint>& input_textures, int input_w, int input_h) {
-    op->apply(input_textures, input_w, input_h);
+  // marks an op and everything downstream of it for re-evaluation.
+  // an op is never left clean while something upstream of it is dirty, so
+  // the walk stops at ops that are already dirty
+  void invalidate(int id) {
+    std::vector<int> stack = { id };
+    while (!stack.empty()) {
+      int cur_id = stack.back();
+      stack.pop_back();
+      Op* cur = get_op_by_id(cur_id);
+      if (!cur || (cur->dirty && cur_id != id)) {
+        continue;
+      }
+      cur->dirty = true;
+      for (int link_id : cur->output_links) {
+        if (Link* link = get_link_by_id(link_id)) {
+          stack.push_back(link->to_id);
+        }
+      }
+    }
   }
 
-  GLuint eval(int root_id, int depth = 0) {
-    std::unique_ptr<Op>& root_op = get_op_by_id(root_id);
-    if (!root_op) {
-      return 0;
-    } else {
-      std::vector<GLuint> input_textures;
-      input_textures.reserve(root_op->input_ids.size());
-      int input_w = 0;
-      int input_h = 0;
-
-      for (int input_id : root_op->input_ids) {
-        if (input_id == root_op->id) {
-          LOG_WARN("Detected self-referencing input for op id=%d, skipping", root_op->id);
+  // compiles the graph rooted at root_id into a flat plan where every op
+  // comes after all of its inputs: the reachable set in depth first
+  // postorder, which needs no cycle checks as the graph is kept acyclic at
+  // link time. run when the root changes; edits patch the plan instead,
+  // see patch_plan
+  void compile_plan(int root_id) {
+    for (PlanStep& step : plan) {
+      if (step.op) {
+        step.op->plan_index = -1;
+      }
+    }
+    plan.clear();
+    plan_root_id = root_id;
+    plan_dirty = false;
+    for (int id : plan_touched) {
+      if (Op* op = get_op_by_id(id)) {
+        op->plan_touched = false;
+      }
+    }
+    plan_touched.clear();
+    plan_holes.clear();
+    plan_ord_lo = INT_MAX;
+    plan_ord_hi = INT_MIN;
+    for (auto& op : ops) {
+      op->plan_refs = 0;
+    }
+
+    Op* root = get_op_by_id(root_id);
+    if (!root) {
+      return;
+    }
+
+    // each input's subtree is finished before the next one starts, taking
+    // the one holding the most results while it runs first, so fewer results
+    // are alive at once when low_vram releases them after their last use.
+    // live_need is that number; inputs are finished before their consumer,
+    // so it is known by the time the consumer is
+    struct Frame {
+      Op* op;
+      std::vector<Op*> inputs;
+      size_t next;
+    };
+    auto by_need = [](const Op* a, const Op* b) { return a->live_need > b->live_need; };
+    for (int pass = 0; pass < 2; pass++) {
+      uint32_t mark = ++walk_mark;
+      plan_order.clear();
+      std::vector<Frame> frames;
+      frames.push_back({ root, {}, 0 });
+      root->visit_mark = mark;
+      while (!frames.empty()) {
+        Frame& frame = frames.back();
+        if (frame.inputs.empty() && frame.next == 0) {
+          for (int input_id : frame.op->input_ids) {
+            Op* input = get_op_by_id(input_id);
+            if (input) {
+              frame.inputs.push_back(input);
+            }
+          }
+          if (pass == 1) {
+            std::stable_sort(frame.inputs.begin(), frame.inputs.end(), by_need);
+          }
+        }
+        if (frame.next < frame.inputs.size()) {
+          Op* input = frame.inputs[frame.next++];
+          if (input->visit_mark != mark) {
+            input->visit_mark = mark;
+            frames.push_back({ input, {}, 0 });
+          }
           continue;
         }
-        // ? this might be inefficient
-        if (input_w == 0 && input_h == 0) {
-          std::unique_ptr<Op>& input_op = get_op_by_id(input_id);
-          if (input_op) {
-            input_w = input_op->out_w;
-            input_h = input_op->out_h;
+        Op* op = frame.op;
+        if (pass == 0) {
+          std::vector<Op*> inputs = frame.inputs;
+          std::sort(inputs.begin(), inputs.end(), by_need);
+          op->live_need = 1;
+          for (size_t i = 0; i < inputs.size(); i++) {
+            op->live_need = std::max(op->live_need, inputs[i]->live_need + (int)i);
+          }
+        }
+        plan_order.push_back(op);
+        frames.pop_back();
+      }
+    }
+
+    plan.resize(plan_order.size());
+    for (size_t i = 0; i < plan_order.size(); i++) {
+      plan_order[i]->plan_index = (int)i;
+      plan[i].op = plan_order[i];
+    }
+    root->plan_refs = 1;
+    for (PlanStep& step : plan) {
+      link_step(step);
+      for (int input_step : step.input_steps) {
+        if (input_step >= 0) {
+          plan[input_step].op->plan_refs++;
+        }
+      }
+    }
+    renumber_topo_ords();
+
+    find_constants();
+    for (PlanStep& step : plan) {
+      step.can_defer = step_can_defer(step);
+    }
+    fuse_plan();
+  }
+
+  // makes topo_ord follow the plan's order, so the plan stays sorted by it
+  // as patch_plan updates it. nothing outside the plan feeds into it, so the
+  // other ops keep their relative order after it
+  void renumber_topo_ords() {
+    topo_forward.clear();
+    for (auto& op : ops) {
+      if (op->plan_index < 0) {
+        topo_forward.push_back(op.get());
+      }
+    }
+    std::sort(topo_forward.begin(), topo_forward.end(),
+      [](const Op* a, const Op* b) { return a->topo_ord < b->topo_ord; });
+    int ord = 0;
+    for (PlanStep& step : plan) {
+      step.op->topo_ord = ord++;
+    }
+    for (Op* op : topo_forward) {
+      op->topo_ord = ord++;
+    }
+    next_topo_ord = ord;
+  }
+
+  // points a step at the steps of its op's inputs
+  void link_step(PlanStep& step) {
+    Op* op = step.op;
+    step.input_steps.clear();
+    for (int input_id : op->input_ids) {
+      Op* input = get_op_by_id(input_id);
+      step.input_steps.push_back(input ? input->plan_index : -1);
+    }
+    step.input_textures.assign(op->input_ids.size(), 0);
+    op->input_xforms.assign(op->input_ids.size(), UVXform{});
+    op->input_constants.assign(op->input_ids.size(), nullptr);
+  }
+
+  // steps of the ops reading step i's output in the plan
+  template <typename F>
+  void for_each_consumer(int i, F f) {
+    for (int link_id : plan[i].op->output_links) {
+      Op* consumer = get_link_consumer(link_id);
+      if (consumer && consumer->plan_index >= 0) {
+        f(consumer->plan_index);
+      }
+    }
+  }
+
+  // brings the plan up to date with the edits made since it was compiled or
+  // last patched, so an edit costs what it affects rather than a recompile.
+  // steps of ops that left the plan are dropped, ops that entered it are
+  // merged in by topo_ord, and the slice whose ords topo_insert_edge
+  // reassigned is re-sorted. steps after the first one that moved only have
+  // their indices remapped; constants, deferral and fusion are redone for
+  // the touched steps (see touch) and as far as their changes reach. the
+  // order stays valid, but only what compile_plan laid out keeps its
+  // memory-aware order until the next compile
+  void patch_plan() {
+    int old_size = (int)plan.size();
+    int first = old_size; // first step whose index changes
+
+    // sort out the touched ops. dissolving a leaving step's group touches
+    // the group's ops, which are looked at in turn
+    plan_order.clear(); // ops entering the plan
+    patch_ops.clear(); // touched ops in the plan
+    for (size_t k = 0; k < plan_touched.size(); k++) {
+      Op* op = get_op_by_id(plan_touched[k]);
+      if (!op) {
+        continue;
+      }
+      op->plan_touched = false;
+      if (op->plan_refs == 0) {
+        if (op->plan_index >= 0) {
+          dissolve_group(op->plan_index);
+          plan[op->plan_index].op = nullptr;
+          plan_holes.push_back(op->plan_index);
+          op->plan_index = -1;
+        }
+        continue;
+      }
+      if (op->plan_index < 0) {
+        plan_order.push_back(op);
+      }
+      patch_ops.push_back(op);
+    }
+    plan_touched.clear();
+
+    // drop the steps of ops that left
+    if (!plan_holes.empty()) {
+      int hole = *std::min_element(plan_holes.begin(), plan_holes.end());
+      int out = hole;
+      for (int i = hole; i < old_size; i++) {
+        if (plan[i].op) {
+          if (out != i) {
+            plan[out] = std::move(plan[i]);
+          }
+          out++;
+        }
+      }
+      plan.resize(out);
+      plan_holes.clear();
+      first = std::min(first, hole);
+    }
+
+    // re-sort the steps whose ords were reassigned. before and after, the
+    // ones with ords in [plan_ord_lo, plan_ord_hi] are contiguous
+    if (plan_ord_lo <= plan_ord_hi) {
+      auto by_ord = [](const PlanStep& a, const PlanStep& b) { return a.op->topo_ord < b.op->topo_ord; };
+      auto lo = std::partition_point(plan.begin(), plan.end(),
+        [&](const PlanStep& step) { return step.op->topo_ord < plan_ord_lo; });
+      auto hi = std::partition_point(lo, plan.end(),
+        [&](const PlanStep& step) { return step.op->topo_ord <= plan_ord_hi; });
+      if (!std::is_sorted(lo, hi, by_ord)) {
+        std::sort(lo, hi, by_ord);
+        first = std::min(first, (int)(lo - plan.begin()));
+      }
+      plan_ord_lo = INT_MAX;
+      plan_ord_hi = INT_MIN;
+    }
+
+    // merge the entering ops in, from the back
+    if (!plan_order.empty()) {
+      std::sort(plan_order.begin(), plan_order.end(),
+        [](const Op* a, const Op* b) { return a->topo_ord < b->topo_ord; });
+      int i = (int)plan.size() - 1;
+      plan.resize(plan.size() + plan_order.size());
+      int out = (int)plan.size() - 1;
+      for (int j = (int)plan_order.size() - 1; j >= 0; out--) {
+        if (i >= 0 && plan[i].op->topo_ord > plan_order[j]->topo_ord) {
+          plan[out] = std::move(plan[i--]);
+        } else {
+          plan[out] = PlanStep{};
+          plan[out].op = plan_order[j--];
+        }
+      }
+      first = std::min(first, out + 1);
+    }
+
+    // steps from first on have moved. their ops still carry their old
+    // index, which maps the indices the steps hold
+    if (first < (int)plan.size()) {
+      patch_remap.assign(old_size, -1);
+      for (int i = first; i < (int)plan.size(); i++) {
+        Op* op = plan[i].op;
+        if (op->plan_index >= 0) {
+          patch_remap[op->plan_index] = i;
+        }
+        op->plan_index = i;
+      }
+      auto remap = [&](int& index) {
+        if (index >= first) {
+          index = patch_remap[index];
+        }
+      };
+      for (int i = first; i < (int)plan.size(); i++) {
+        PlanStep& step = plan[i];
+        for (int& input_step : step.input_steps) {
+          remap(input_step);
+        }
+        for (int& input_step : step.fused_input_steps) {
+          remap(input_step);
+        }
+        for (Op* fused : step.fused_ops) {
+          if (fused != step.op && fused->plan_index >= 0) {
+            plan[fused->plan_index].fused_into = i;
+          }
+        }
+      }
+    }
+
+    // the touched steps' inputs may have changed
+    std::vector<int>& changed = patch_steps;
+    changed.clear();
+    for (Op* op : patch_ops) {
+      link_step(plan[op->plan_index]);
+      changed.push_back(op->plan_index);
+    }
+    size_t touched_count = changed.size();
+
+    // constants flow downstream, so in plan order a step is only looked at
+    // after every input that changed. changed collects the touched steps and
+    // those whose constness changed
+    uint32_t touched_mark = ++walk_mark;
+    uint32_t queued_mark = ++walk_mark;
+    std::priority_queue<int, std::vector<int>, std::greater<int>> forward;
+    for (int i : changed) {
+      plan[i].op->visit_mark = touched_mark;
+      forward.push(i);
+    }
+    while (!forward.empty()) {
+      int i = forward.top();
+      forward.pop();
+      PlanStep& step = plan[i];
+      bool constant = step_constant(step);
+      if (constant == step.constant) {
+        continue;
+      }
+      step.constant = constant;
+      if (step.op->visit_mark != touched_mark) {
+        changed.push_back(i);
+      }
+      for_each_consumer(i, [&](int consumer) {
+        Op* op = plan[consumer].op;
+        if (op->visit_mark != touched_mark && op->visit_mark != queued_mark) {
+          op->visit_mark = queued_mark;
+          forward.push(consumer);
+        }
+      });
+    }
+
+    // whether a constant is read as a texture flows upstream, from the
+    // changed steps to their inputs and on through bypassed constants
+    uint32_t mark = ++walk_mark;
+    std::priority_queue<int> backward;
+    auto queue_backward = [&](int i) {
+      if (i >= 0 && plan[i].op->visit_mark != mark) {
+        plan[i].op->visit_mark = mark;
+        backward.push(i);
+      }
+    };
+    for (int i : changed) {
+      queue_backward(i);
+      for (int input_step : plan[i].input_steps) {
+        queue_backward(input_step);
+      }
+    }
+    while (!backward.empty()) {
+      int i = backward.top();
+      backward.pop();
+      PlanStep& step = plan[i];
+      bool needs_texture = step_needs_texture(i);
+      if (needs_texture != step.needs_texture) {
+        step.needs_texture = needs_texture;
+        if (step.constant && step.op->bypass) {
+          queue_backward(step.input_steps[0]);
+        }
+      }
+    }
+
+    // deferral depends on the step and whether its consumers bypass it
+    for (size_t k = 0; k < touched_count; k++) {
+      PlanStep& step = plan[changed[k]];
+      step.can_defer = step_can_defer(step);
+      for (int input_step : step.input_steps) {
+        if (input_step >= 0) {
+          plan[input_step].can_defer = step_can_defer(plan[input_step]);
+        }
+      }
+    }
+
+    // fusion: a step's place in a group depends on the step itself and its
+    // first input (see fuse_prev), so the groups to redo are those of the
+    // changed steps, their consumers and the first inputs of either
+    mark = ++walk_mark;
+    std::vector<int>& regroup = patch_regroup;
+    regroup.clear();
+    auto queue_regroup = [&](int i) {
+      if (i >= 0 && plan[i].op->visit_mark != mark) {
+        plan[i].op->visit_mark = mark;
+        regroup.push_back(i);
+      }
+    };
+    for (int i : changed) {
+      queue_regroup(i);
+      for_each_consumer(i, queue_regroup);
+    }
+    for (size_t k = 0, n = regroup.size(); k < n; k++) {
+      const PlanStep& step = plan[regroup[k]];
+      queue_regroup(step.input_steps.empty() ? -1 : step.input_steps[0]);
+    }
+    for (size_t k = 0; k < regroup.size(); k++) {
+      int head = group_head(regroup[k]);
+      if (head < 0) {
+        continue;
+      }
+      for (Op* fused : plan[head].fused_ops) {
+        queue_regroup(fused->plan_index);
+      }
+      clear_group(head);
+    }
+    mark = ++walk_mark;
+    for (int i : regroup) {
+      // the group a step ends up in is built from its last step
+      while (plan[i].op->visit_mark != mark) {
+        plan[i].op->visit_mark = mark;
+        int next = fuse_next(i);
+        if (next < 0) {
+          build_group(i);
+          break;
+        }
+        i = next;
+      }
+    }
+  }
+
+  // whether every consumer of op in the plan samples it through its
+  // out_xform. bypassed consumers pass the texture on instead, so they don't
+  bool consumers_sample_xforms(Op* op) {
+    for (int link_id : op->output_links) {
+      Op* to = get_link_consumer(link_id);
+      if (to && to->plan_index >= 0 && (to->bypass || !to->samples_input_xforms())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // whether a step's transform can be left to its consumers' sampling, see
+  // prepare_step
+  bool step_can_defer(const PlanStep& step) {
+    AffineMat3 unused;
+    return step.op->input_uv_matrix(unused) && consumers_sample_xforms(step.op);
+  }
+
+  // whether a step's output is constant (see Op::folds_constants). this
+  // only depends on the graph; the values are folded when the plan runs
+  bool step_constant(const PlanStep& step) const {
+    if (step.op->bypass) {
+      int input_step = step.input_steps.empty() ? -1 : step.input_steps[0];
+      return input_step >= 0 && plan[input_step].constant;
+    }
+    bool constant = step.op->folds_constants();
+    for (int input_step : step.input_steps) {
+      constant = constant && input_step >= 0 && plan[input_step].constant;
+    }
+    return constant;
+  }
+
+  // whether a consumer reads step i as a texture rather than a uniform. the
+  // present pass samples the output, and a bypassed step passes its input's
+  // texture on. pointwise passes take constants as uniforms
+  bool step_needs_texture(int i) {
+    if (i == (int)plan.size() - 1) {
+      return true;
+    }
+    if (!plan[i].constant) {
+      return false;
+    }
+    for (int link_id : plan[i].op->output_links) {
+      const Link* link = get_link_by_id(link_id);
+      Op* to = link ? get_op_by_id(link->to_id) : nullptr;
+      if (!to || to->plan_index < 0) {
+        continue;
+      }
+      const PlanStep& consumer = plan[to->plan_index];
+      if (consumer.constant && to->bypass) {
+        if (link->input_idx == 0 && consumer.needs_texture) {
+          return true;
+        }
+      } else if (!consumer.constant && !to->pointwise_source()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // marks the steps whose output is constant, and which of them consumers
+  // read as a texture
+  void find_constants() {
+    for (PlanStep& step : plan) {
+      step.constant = step_constant(step);
+    }
+    for (int i = (int)plan.size() - 1; i >= 0; i--) {
+      plan[i].needs_texture = step_needs_texture(i);
+    }
+  }
+
+  static bool fusible(const PlanStep& step) {
+    return step.op->pointwise_source() != nullptr && !step.op->bypass && !step.constant;
+  }
+
+  // the step step i absorbs into its pass, -1 if none. an op is absorbed into
+  // the op reading its output when that is its only consumer, reading it as
+  // its first input at the same size
+  int fuse_prev(int i) const {
+    const PlanStep& step = plan[i];
+    if (!fusible(step) || !step.op->use_input_size || step.input_steps.empty()) {
+      return -1;
+    }
+    int prev = step.input_steps[0];
+    if (prev < 0 || !fusible(plan[prev]) || plan[prev].op->output_links.size() != 1) {
+      return -1;
+    }
+    return prev;
+  }
+
+  // the step absorbing step i into its pass, -1 if none
+  int fuse_next(int i) {
+    if (plan[i].op->output_links.size() != 1) {
+      return -1;
+    }
+    Op* consumer = get_link_consumer(plan[i].op->output_links[0]);
+    if (!consumer || consumer->plan_index < 0) {
+      return -1;
+    }
+    return fuse_prev(consumer->plan_index) == i ? consumer->plan_index : -1;
+  }
+
+  // last step of the group step i is in, -1 if it isn't in one
+  int group_head(int i) const {
+    if (plan[i].fused_into >= 0) {
+      return plan[i].fused_into;
+    }
+    return plan[i].fused_ops.empty() ? -1 : i;
+  }
+
+  void clear_group(int head) {
+    PlanStep& step = plan[head];
+    for (Op* fused : step.fused_ops) {
+      if (fused->plan_index >= 0) {
+        plan[fused->plan_index].fused_into = -1;
+      }
+    }
+    step.fused_stages.clear();
+    step.fused_ops.clear();
+    step.fused_input_steps.clear();
+    step.fused_prog = 0;
+    step.fused_uniforms = nullptr;
+  }
+
+  // takes apart the group step i is in before one of its ops leaves the
+  // plan, touching the others so patch_plan regroups them
+  void dissolve_group(int i) {
+    int head = group_head(i);
+    if (head < 0) {
+      return;
+    }
+    for (Op* fused : plan[head].fused_ops) {
+      touch(fused);
+    }
+    clear_group(head);
+  }
+
+  // merges the chain of steps absorbed into step head (see fuse_prev) into
+  // a single pass (see fusion.hpp). absorbed ops still get keys, so caching
+  // works as before, but render nothing
+  void build_group(int head) {
+    std::vector<int>& chain = patch_chain;
+    chain.clear();
+    for (int i = head; i >= 0; i = fuse_prev(i)) {
+      chain.push_back(i);
+    }
+    PlanStep& step = plan[head];
+    clear_group(head);
+    if (chain.size() < 2) {
+      // a group of one runs as a normal step
+      return;
+    }
+    std::reverse(chain.begin(), chain.end());
+    for (size_t k = 0; k < chain.size(); k++) {
+      PlanStep& fused = plan[chain[k]];
+      FusedStage stage = { fused.op->pointwise_source(), {} };
+      size_t first_input = 0;
+      if (k > 0) {
+        // the previous stage's result
+        stage.args.push_back(-(int)k);
+        first_input = 1;
+      }
+      for (size_t j = first_input; j < fused.input_steps.size(); j++) {
+        stage.args.push_back((int)step.fused_input_steps.size());
+        step.fused_input_steps.push_back(fused.input_steps[j]);
+      }
+      step.fused_stages.push_back(stage);
+      step.fused_ops.push_back(fused.op);
+      if (chain[k] != head) {
+        fused.fused_into = head;
+      }
+    }
+
+    step.fused_prog = get_fused_program(step.fused_stages);
+    // uniforms are looked up once per program, so running the step uses no
+    // names
+    FusedSlots& slots = fused_slots(step.fused_prog);
+    if (slots.stages.size() != step.fused_ops.size()) {
+      resolve_fused_inputs(slots.inputs, step.fused_prog, step.fused_input_steps.size());
+      slots.stages.resize(step.fused_ops.size());
+      for (size_t k = 0; k < step.fused_ops.size(); k++) {
+        slots.stages[k].resolve(
+          step.fused_prog, fused_stage_prefix((int)k), step.fused_ops[k]->pointwise_uniforms());
+      }
+    }
+    step.fused_uniforms = &slots;
+  }
+
+  // merges chains of pointwise ops into single passes, see build_group
+  void fuse_plan() {
+    for (size_t i = 0; i < plan.size(); i++) {
+      clear_group((int)i);
+    }
+    for (int i = 0; i < (int)plan.size(); i++) {
+      if (fuse_next(i) < 0) {
+        build_group(i);
+      }
+    }
+  }
+
+  // moves an op's result out of it, leaving it with none
+  CachedResult detach_result(Op* op) {
+    CachedResult result;
+    result.fbo = op->layer_fbo;
+    result.out_w = op->out_w;
+    result.out_h = op->out_h;
+    result.valid_roi = op->valid_roi;
+    result.valid_scale = op->valid_scale;
+    op->layer_fbo = FBO{};
+    op->valid_roi = uvrect_empty();
+    op->valid_scale = 0.0f;
+    return result;
+  }
+
+  void attach_result(Op* op, const CachedResult& result) {
+    op->layer_fbo = result.fbo;
+    op->out_w = result.out_w;
+    op->out_h = result.out_h;
+    op->valid_roi = result.valid_roi;
+    op->valid_scale = result.valid_scale;
+  }
+
+  // content hash of a step's result, from the op and its inputs' keys
+  uint64_t step_key(const PlanStep& step) const {
+    uint64_t key = step.op->hash_content();
+    for (int input_step : step.input_steps) {
+      key = hash_value(key, input_step < 0 ? 0 : plan[input_step].op->result_key);
+    }
+    return key;
+  }
+
+  // forgets an op's result, its target has been handed on already
+  void clear_result(Op* op) {
+    op->layer_fbo = FBO{};
+    op->valid_roi = uvrect_empty();
+    op->valid_scale = 0.0f;
+    op->out_tex = 0;
+  }
+
+  // a target free for the rest of the run, see allocate_targets
+  void free_target(const FBO& fbo) {
+    if (fbo.tex.id != 0) {
+      plan_free[FBOPool::bucket_key(fbo.tex.w, fbo.tex.h, fbo.tex.format)].push_back(fbo);
+    }
+  }
+
+  FBO take_target(int w, int h, GLenum format) {
+    auto it = plan_free.find(FBOPool::bucket_key(w, h, format));
+    if (it != plan_free.end() && !it->second.empty()) {
+      FBO fbo = it->second.back();
+      it->second.pop_back();
+      return fbo;
+    }
+    FBO fbo = format == GL_RGBA8 ? cache.recycle(w, h) : FBO{};
+    return fbo.tex.id != 0 ? fbo : fbo_pool().acquire(w, h, format);
+  }
+
+  // ops that don't render hand their targets back to the cache
+  void drop_result(Op* op) {
+    if (op->layer_fbo.tex.id != 0) {
+      cache.put(op->result_key, detach_result(op));
+    }
+  }
+
+  // metadata pass, in plan order and without touching the gpu besides
+  // loading sources: works out each op's size, format and data window from
+  // its inputs', refreshes the keys of invalidated ops and decides what each
+  // step does. a changed key swaps in a cached result if there is one
+  void prepare_step(PlanStep& step) {
+    Op* op = step.op;
+    int input_w = 0;
+    int input_h = 0;
+    input_windows.assign(step.input_steps.size(), uvrect_empty());
+    for (size_t i = 0; i < step.input_steps.size(); i++) {
+      int input_step = step.input_steps[i];
+      Op* input = input_step < 0 ? nullptr : plan[input_step].op;
+      op->input_xforms[i] = input ? input->out_xform : UVXform{};
+      op->input_constants[i] = input && input->is_constant ? input->constant_value : nullptr;
+      input_windows[i] = input ? input->data_window : uvrect_empty();
+      if (input && input_w == 0 && input_h == 0) {
+        input_w = input->out_w;
+        input_h = input->out_h;
+      }
+    }
+    int first_step = step.input_steps.empty() ? -1 : step.input_steps[0];
+    Op* first = first_step < 0 ? nullptr : plan[first_step].op;
+
+    bool dirty = op->dirty;
+    op->dirty = false;
+    step.refill |= dirty;
+    op->out_xform = UVXform{};
+    op->is_constant = false;
+
+    if (op->bypass) {
+      // a bypassed op's output is its first input's
+      step.kind = StepKind::Alias;
+      drop_result(op);
+      if (first) {
+        op->out_xform = first->out_xform;
+        op->is_constant = first->is_constant;
+        std::memcpy(op->constant_value, first->constant_value, sizeof(op->constant_value));
+        op->out_w = first->out_w;
+        op->out_h = first->out_h;
+        op->out_format = first->out_format;
+      }
+      op->data_window = first ? first->data_window : uvrect_empty();
+      op->result_key = first ? first->result_key : 0;
+      return;
+    }
+
+    op->apply_input_size(input_w, input_h);
+    {
+      GpuResourceScope scope(op->id);
+      GlCallScope calls(op->id);
+      op->prepare();
+    }
+    op->data_window = op->output_window(input_windows);
+
+    if (step.constant) {
+      // see fold_step
+      step.kind = StepKind::Constant;
+      bool has_texture = op->layer_fbo.tex.w == 1 && op->layer_fbo.tex.h == 1;
+      if (!step.needs_texture || !has_texture) {
+        drop_result(op);
+      }
+      if (dirty) {
+        op->result_key = step_key(step);
+        op->fold_constant(op->input_constants, op->constant_value);
+      }
+      op->is_constant = true;
+      return;
+    }
+
+    if (step.can_defer) {
+      // a deferred transform renders nothing. its output is its input's
+      // texture with the transform's matrix folded into out_xform, which
+      // consumers apply when they sample it, so stacked transforms resample
+      // once and an identity transform costs nothing. concatenating two
+      // keeps the first one's bounds in UVXform::clip; a third would need
+      // another clip, so it renders instead (which still resamples once)
+      AffineMat3 m;
+      op->input_uv_matrix(m);
+      bool identity = amat3_is_identity(m);
+      if (!first || identity || amat3_is_identity(first->out_xform.clip)) {
+        step.kind = StepKind::Deferred;
+        drop_result(op);
+        if (dirty) {
+          op->result_key = step_key(step);
+        }
+        if (first && identity) {
+          op->out_xform = first->out_xform;
+        } else if (first) {
+          // the input's own bounds are the texture's, unless it is deferred too
+          op->out_xform.matrix = amat3_mul(first->out_xform.matrix, m);
+          op->out_xform.clip = amat3_is_identity(first->out_xform.matrix) ? amat3_identity() : m;
+        }
+        return;
+      }
+    }
+
+    if (step.fused_into >= 0) {
+      // evaluated by a later step's pass, only its key and size are needed
+      step.kind = StepKind::Fused;
+      drop_result(op);
+      if (dirty) {
+        op->result_key = step_key(step);
+      }
+      return;
+    }
+
+    step.kind = StepKind::Render;
+    if (dirty) {
+      uint64_t key = step_key(step);
+      if (key != op->result_key) {
+        // keep the current result around in case the op comes back to it
+        cache.put(op->result_key, detach_result(op));
+        CachedResult cached;
+        if (cache.take(key, cached)) {
+          attach_result(op, cached);
+        }
+        op->result_key = key;
+      }
+    }
+  }
+
+  // second pass of run_plan, in reverse plan order: works out which steps
+  // have to run, starting from the output. a rendering step only reads its
+  // inputs if its result doesn't cover the region and resolution requested;
+  // steps that pass their input on read it whenever they are read.
+  // last_use is the last step reading a step's texture, through any steps
+  // passing it on. in low vram mode unpinned results are released to the
+  // pool right after it, so intermediates share a few textures
+  void plan_demand() {
+    for (PlanStep& step : plan) {
+      step.needed = false;
+      step.renders = false;
+      step.last_use = -1;
+      step.release_next = -1;
+    }
+    release_heads.assign(plan.size(), -1);
+    plan.back().needed = true;
+    plan.back().last_use = INT_MAX;
+
+    for (int i = (int)plan.size() - 1; i >= 0; i--) {
+      PlanStep& step = plan[i];
+      Op* op = step.op;
+      if (!step.needed) {
+        continue;
+      }
+      int reader = i;
+      size_t reads = step.input_steps.size();
+      switch (step.kind) {
+        case StepKind::Render: {
+          bool covered = op->layer_fbo.tex.id != 0
+            && op->valid_scale >= op->render_scale
+            && uvrect_contains(op->valid_roi, op->render_roi);
+          step.renders = !covered && !uvrect_is_empty(op->render_roi);
+          if (!step.renders) {
+            reads = 0;
           }
+          break;
+        }
+        case StepKind::Alias:
+        case StepKind::Deferred:
+          reader = step.last_use;
+          reads = std::min<size_t>(reads, 1);
+          break;
+        case StepKind::Fused:
+          reader = step.last_use;
+          break;
+        case StepKind::Constant:
+          // inputs are constants too, and folded already
+          reads = 0;
+          break;
+      }
+      for (size_t j = 0; j < reads; j++) {
+        int input_step = step.input_steps[j];
+        if (input_step >= 0) {
+          plan[input_step].needed = true;
+          plan[input_step].last_use = std::max(plan[input_step].last_use, reader);
         }
-        input_textures.push_back(eval(input_id));
       }
+    }
 
-      render(root_op.get(), input_textures, input_w, input_h);
+    if (!low_vram) {
+      return;
+    }
+    for (int i = 0; i < (int)plan.size(); i++) {
+      PlanStep& step = plan[i];
+      if (step.kind != StepKind::Render || step.op->pinned || step.last_use == INT_MAX) {
+        continue;
+      }
+      if (!step.needed) {
+        // nothing reads it this run
+        free_target(step.op->layer_fbo);
+        clear_result(step.op);
+        continue;
+      }
+      int at = std::max(step.last_use, i);
+      step.release_next = release_heads[at];
+      release_heads[at] = i;
+    }
+  }
 
-      // if root, update present size
-      if (depth == 0) {
-        present_w = root_op->out_w;
-        present_h = root_op->out_h;
+  // gives every step that renders this run a target of its size and format
+  // before anything is drawn, in plan order. a target released after step i
+  // (see plan_demand) is free for the steps after it, so the execute pass
+  // itself never allocates
+  void allocate_targets() {
+    for (int i = 0; i < (int)plan.size(); i++) {
+      PlanStep& step = plan[i];
+      Op* op = step.op;
+      if (step.needed && step.kind == StepKind::Render && step.renders) {
+        FBO& fbo = op->layer_fbo;
+        int w = op->target_w();
+        int h = op->target_h();
+        if (fbo.tex.id != 0 && (fbo.tex.w != w || fbo.tex.h != h || fbo.tex.format != op->out_format)) {
+          // the op renders afresh, nothing reads the old target anymore
+          free_target(fbo);
+          fbo = FBO{};
+          op->valid_roi = uvrect_empty();
+          op->valid_scale = 0.0f;
+        }
+        if (fbo.tex.id == 0) {
+          fbo = take_target(w, h, op->out_format);
+          fbo.tex.set_filter_mode(op->filter_mode);
+        }
+        // only used while the op runs, so free for the steps after it
+        op->scratch_fbos.clear();
+        for (GLenum format : op->scratch_formats) {
+          op->scratch_fbos.push_back(take_target(w, h, format));
+        }
+        for (const FBO& scratch : op->scratch_fbos) {
+          free_target(scratch);
+        }
+      }
+      if (step.needed && step.kind == StepKind::Constant && step.needs_texture && op->layer_fbo.tex.id == 0) {
+        op->layer_fbo = take_target(1, 1, GL_RGBA8);
+        step.refill = true;
       }
+      for (int r = release_heads[i]; r >= 0; r = plan[r].release_next) {
+        free_target(plan[r].op->layer_fbo);
+      }
+    }
+  }
+
+  // third pass of run_plan, in plan order: renders the steps that need it
+  void execute_step(PlanStep& step) {
+    Op* op = step.op;
+    GlCallScope calls(op->id);
+    int first_step = step.input_steps.empty() ? -1 : step.input_steps[0];
+    Op* first = first_step < 0 ? nullptr : plan[first_step].op;
+    for (size_t i = 0; i < step.input_steps.size(); i++) {
+      int input_step = step.input_steps[i];
+      Op* input = input_step < 0 ? nullptr : plan[input_step].op;
+      step.input_textures[i] = input ? input->out_tex : 0;
+    }
 
-      return root_op->layer_fbo.tex.id;
+    switch (step.kind) {
+      case StepKind::Alias:
+      case StepKind::Deferred:
+        op->out_tex = first ? first->out_tex : 0;
+        break;
+      case StepKind::Fused:
+        op->out_tex = 0;
+        break;
+      case StepKind::Constant:
+        fold_step(step);
+        break;
+      case StepKind::Render:
+        if (step.renders) {
+          GpuResourceScope scope(op->id);
+          TraceScope trace(op->get_type_name(), op->id);
+          gpu_timers.begin(op->id, op->get_type_name());
+          if (step.fused_stages.empty()) {
+            render(op, step.input_textures);
+          } else {
+            render_fused(step);
+          }
+          gpu_timers.end();
+          op->scratch_fbos.clear(); // handed back in allocate_targets
+          if (op->layer_fbo.tex.id != 0) {
+            op->layer_fbo.tex.set_filter_mode(op->filter_mode);
+          }
+          // a pass only touches render_roi, so at the same scale what was valid
+          // before still is (see eval's refinement strips)
+          UVRect merged;
+          if (op->valid_scale == op->render_scale && uvrect_merge(op->valid_roi, op->render_roi, merged)) {
+            op->valid_roi = merged;
+          } else {
+            op->valid_roi = op->render_roi;
+          }
+          op->valid_scale = op->render_scale;
+        }
+        op->out_tex = op->layer_fbo.tex.id;
+        break;
+    }
+  }
+
+  // a constant step renders nothing. its value is folded on the cpu from its
+  // inputs' values (see prepare_step), and pointwise consumers read it as a
+  // uniform. when another consumer needs a texture it gets a 1x1 one, filled
+  // by a clear, which samples the same everywhere
+  void fold_step(PlanStep& step) {
+    Op* op = step.op;
+    if (!step.needs_texture) {
+      op->out_tex = 0;
+      return;
+    }
+    if (step.refill) {
+      const float* c = op->constant_value;
+      gl_bind_framebuffer(GL_FRAMEBUFFER, op->layer_fbo.fbo_id);
+      gl_scissor_test(false);
+      gl_clear_color(c[0], c[1], c[2], c[3]);
+      gl_clear(GL_COLOR_BUFFER_BIT);
+      step.refill = false;
+    }
+    op->out_tex = op->layer_fbo.tex.id;
+  }
+
+  // the region of interest starts at the requested part of the output and
+  // flows upstream through each op's input_roi. an input shared by several
+  // consumers gets the union of their regions and the highest resolution
+  void propagate_roi(const UVRect& roi, float scale) {
+    for (PlanStep& step : plan) {
+      step.op->render_roi = uvrect_empty();
+      step.op->render_scale = 0.0f;
+    }
+    Op* root = plan.back().op;
+    root->render_roi = roi;
+    root->render_scale = scale;
+
+    for (auto it = plan.rbegin(); it != plan.rend(); ++it) {
+      Op* op = it->op;
+      if (uvrect_is_empty(op->render_roi)) {
+        continue;
+      }
+      for (size_t i = 0; i < it->input_steps.size(); i++) {
+        if (it->input_steps[i] < 0) {
+          continue;
+        }
+        Op* input = plan[it->input_steps[i]].op;
+        UVRect input_roi = op->bypass ? op->render_roi : op->input_roi(op->render_roi, (int)i);
+        input->render_roi = uvrect_union(input->render_roi, uvrect_clamp(input_roi));
+        input->render_scale = std::max(input->render_scale, op->render_scale);
+      }
     }
   }
+
+  // upper bound on the op pixels rendering a request costs, ignoring what is
+  // already covered
+  double plan_cost(const UVRect& roi, float scale) {
+    propagate_roi(roi, scale);
+    double cost = 0.0;
+    for (PlanStep& step : plan) {
+      const Op* op = step.op;
+      if (step.kind != StepKind::Render || uvrect_is_empty(op->render_roi)) {
+        continue;
+      }
+      double w = (op->render_roi.x1 - op->render_roi.x0) * op->out_w * op->render_scale;
+      double h = (op->render_roi.y1 - op->render_roi.y0) * op->out_h * op->render_scale;
+      cost += w * h;
+    }
+    return cost;
+  }
+
+  // metadata pass over the whole plan, see prepare_step. run once a frame
+  // before any request, so sizes and costs are current
+  void prepare_plan() {
+    plan_fused_ops = 0;
+    plan_deferred_ops = 0;
+    plan_constant_ops = 0;
+    for (PlanStep& step : plan) {
+      prepare_step(step);
+      plan_fused_ops += step.kind == StepKind::Fused;
+      plan_deferred_ops += step.kind == StepKind::Deferred;
+      plan_constant_ops += step.kind == StepKind::Constant;
+    }
+  }
+
+  // brings the plan up to date for a request, after prepare_plan
+  void run_plan(const UVRect& roi, float scale) {
+    propagate_roi(roi, scale);
+    plan_demand();
+    allocate_targets();
+    for (int i = 0; i < (int)plan.size(); i++) {
+      if (plan[i].needed) {
+        execute_step(plan[i]);
+      }
+      for (int r = release_heads[i]; r >= 0; r = plan[r].release_next) {
+        clear_result(plan[r].op);
+      }
+    }
+    gl_scissor_test(false);
+
+    // released targets no later step took
+    for (auto& [key, fbos] : plan_free) {
+      for (FBO& fbo : fbos) {
+        fbo_pool().release(fbo);
+      }
+      fbos.clear();
+    }
+  }
+
+  // copies the output's current result, rendered for roi, into preview_fbo
+  void copy_to_preview(const UVRect& roi) {
+    // a bypassed or deferred output shows the result of the first op
+    // upstream that isn't
+    int step = (int)plan.size() - 1;
+    while (step >= 0 && (plan[step].kind == StepKind::Alias || plan[step].kind == StepKind::Deferred)) {
+      step = plan[step].input_steps.empty() ? -1 : plan[step].input_steps[0];
+    }
+    if (step < 0 || plan[step].op->layer_fbo.tex.id == 0) {
+      return;
+    }
+    const FBO& src = plan[step].op->layer_fbo;
+    if (preview_fbo.tex.w != src.tex.w || preview_fbo.tex.h != src.tex.h) {
+      fbo_pool().ensure(preview_fbo, src.tex.w, src.tex.h);
+      preview_fbo.tex.set_filter_mode(GL_LINEAR);
+    }
+    gl_bind_framebuffer(GL_READ_FRAMEBUFFER, src.fbo_id);
+    gl_bind_framebuffer(GL_DRAW_FRAMEBUFFER, preview_fbo.fbo_id);
+    gl_blit_framebuffer(
+      0, 0, src.tex.w, src.tex.h,
+      0, 0, src.tex.w, src.tex.h,
+      GL_COLOR_BUFFER_BIT, GL_NEAREST
+    );
+    gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    preview_roi = roi;
+  }
+
+  // whether the output is still being refined over a preview
+  bool show_preview() const {
+    return preview_fbo.tex.id != 0 && refine_y < refine_roi.y1;
+  }
+
+  // part of refine_roi that is final
+  UVRect refined_roi() const {
+    return UVRect{ refine_roi.x0, refine_roi.y0, refine_roi.x1, refine_y };
+  }
+
+  // adjusts the pixel budget from the duration of the last frame. frames
+  // that render nothing say nothing about the budget and are ignored
+  void tune_budget(float frame_dt) {
+    if (budget_used == 0.0) {
+      return;
+    }
+    const float target_dt = 1.0f / 60.0f;
+    if (frame_dt > target_dt * 1.25f) {
+      pixel_budget *= 0.75;
+    } else if (budget_limited) {
+      pixel_budget *= 1.1;
+    }
+    pixel_budget = std::clamp(pixel_budget, 256.0 * 256.0, 4e9);
+  }
+
+  // sets the visible part of the output in uv space, and the output's
+  // resolution on screen relative to its size
+  void set_view(const UVRect& visible, float scale) {
+    // render power of two fractions, so zooming doesn't reallocate every step
+    scale = std::clamp(scale, 1.0f / 64.0f, 1.0f);
+    scale = std::exp2(std::ceil(std::log2(scale)));
+
+    // keep requesting a margin around the view, so small pans stay covered
+    UVRect clamped = uvrect_clamp(visible);
+    if (scale != view_scale || !uvrect_contains(view_request, clamped)) {
+      float mx = (clamped.x1 - clamped.x0) * 0.125f;
+      float my = (clamped.y1 - clamped.y0) * 0.125f;
+      view_request = uvrect_clamp(uvrect_pad(clamped, mx, my));
+      view_scale = scale;
+    }
+  }
+
+  // runs the plan for the output node. when rendering the whole view would
+  // take more than the frame's pixel budget, a coarse preview is rendered
+  // first and the view is then refined in horizontal strips over the
+  // following frames. strips are full width, so what has been refined stays
+  // a rectangle and coverage (see plan_demand) keeps working per op
+  GLuint eval(int root_id) {
+    if (plan_dirty || plan_root_id != root_id) {
+      compile_plan(root_id);
+    } else if (!plan_touched.empty() || !plan_holes.empty() || plan_ord_lo <= plan_ord_hi) {
+      patch_plan();
+    }
+    budget_used = 0.0;
+    budget_limited = false;
+    if (plan.empty()) {
+      return 0;
+    }
+
+    bool changed = false;
+    for (PlanStep& step : plan) {
+      changed |= step.op->dirty;
+    }
+    if (changed) {
+      preview_roi = uvrect_empty();
+    }
+    prepare_plan();
+    bool same_view = refine_scale == view_scale
+      && uvrect_contains(refine_roi, view_request)
+      && uvrect_contains(view_request, refine_roi);
+    if (changed || !same_view) {
+      refine_roi = view_request;
+      refine_scale = view_scale;
+      refine_y = refine_roi.y0;
+    }
+
+    if (refine_y < refine_roi.y1) {
+      double cost = plan_cost(refine_roi, refine_scale);
+      if (!progressive || cost <= pixel_budget) {
+        run_plan(refine_roi, refine_scale);
+        refine_y = refine_roi.y1;
+        budget_used += cost;
+      } else {
+        if (!uvrect_contains(preview_roi, refine_roi)) {
+          // coarse enough to leave most of the budget for refinement
+          float coarse = refine_scale * 0.5f;
+          double coarse_cost = plan_cost(refine_roi, coarse);
+          while (coarse > 1.0f / 64.0f && coarse_cost > pixel_budget * 0.25) {
+            coarse *= 0.5f;
+            coarse_cost = plan_cost(refine_roi, coarse);
+          }
+          run_plan(refine_roi, coarse);
+          copy_to_preview(refine_roi);
+          budget_used += coarse_cost;
+        }
+
+        // refine as many rows as the remaining budget allows, but at least
+        // a few per frame so refinement always makes progress
+        double cost_per_y = cost / (refine_roi.y1 - refine_roi.y0);
+        float min_h = 16.0f / ((float)std::max(1, plan.back().op->out_h) * refine_scale);
+        while (refine_y < refine_roi.y1 && budget_used < pixel_budget) {
+          float h = std::max(min_h, (float)((pixel_budget - budget_used) / cost_per_y));
+          float y1 = std::min(refine_roi.y1, refine_y + h);
+          UVRect strip = { refine_roi.x0, refine_y, refine_roi.x1, y1 };
+          budget_used += plan_cost(strip, refine_scale);
+          run_plan(strip, refine_scale);
+          refine_y = y1;
+        }
+        budget_limited = refine_y < refine_roi.y1;
+      }
+    }
+
+    Op* root = plan.back().op;
+    present_w = root->out_w;
+    present_h = root->out_h;
+    present_xform = root->out_xform;
+    return root->out_tex;
+  }
 };
 static State g_state;
 
+// recent frame times as a graph, with percentiles per phase, see FrameTimes
+static void frame_time_panel(const FrameTimes& frame_times) {
+  // one bar per frame, its cpu time stacked by phase with what no phase
+  // covers on top, and the gpu time as a line over the bars
+  static const ImU32 phase_colors[FrameTimes::PHASE_COUNT] = {
+    IM_COL32(90, 140, 220, 255), // ui
+    IM_COL32(230, 150, 60, 255), // eval
+    IM_COL32(120, 200, 110, 255), // present
+    IM_COL32(170, 110, 200, 255), // swap
+  };
+  const ImU32 other_color = IM_COL32(110, 110, 110, 255);
+  const ImU32 gpu_color = IM_COL32(240, 80, 70, 255);
+
+  float worst = 33.3f;
+  for (int i = 0; i < frame_times.count; i++) {
+    const FrameTimes::Sample& sample = frame_times.at(i);
+    worst = std::max(worst, std::max(sample.cpu_ms, sample.gpu_ms));
+  }
+  ImVec2 origin = ImGui::GetCursorScreenPos();
+  ImVec2 size(ImGui::GetContentRegionAvail().x, 80.0f);
+  ImDrawList* draw = ImGui::GetWindowDrawList();
+  draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(30, 30, 30, 255));
+  float bar_w = size.x / FrameTimes::CAPACITY;
+  float px_per_ms = size.y / worst;
+  float bottom = origin.y + size.y;
+  ImVec2 prev_gpu;
+  bool has_prev_gpu = false;
+  for (int i = 0; i < frame_times.count; i++) {
+    const FrameTimes::Sample& sample = frame_times.at(i);
+    // newest frame at the right edge
+    float x0 = origin.x + (FrameTimes::CAPACITY - frame_times.count + i) * bar_w;
+    float x1 = x0 + std::max(bar_w, 1.0f);
+    float y = bottom;
+    float phases_ms = 0.0f;
+    for (int p = 0; p < FrameTimes::PHASE_COUNT; p++) {
+      float h = sample.phase_ms[p] * px_per_ms;
+      draw->AddRectFilled(ImVec2(x0, y - h), ImVec2(x1, y), phase_colors[p]);
+      y -= h;
+      phases_ms += sample.phase_ms[p];
+    }
+    float other_h = std::max(0.0f, sample.cpu_ms - phases_ms) * px_per_ms;
+    draw->AddRectFilled(ImVec2(x0, y - other_h), ImVec2(x1, y), other_color);
+    if (sample.gpu_ms >= 0.0f) {
+      ImVec2 gpu((x0 + x1) * 0.5f, bottom - sample.gpu_ms * px_per_ms);
+      if (has_prev_gpu) {
+        draw->AddLine(prev_gpu, gpu, gpu_color, 1.5f);
+      }
+      prev_gpu = gpu;
+      has_prev_gpu = true;
+    } else {
+      has_prev_gpu = false;
+    }
+  }
+  ImGui::Dummy(size);
+  for (int p = 0; p < FrameTimes::PHASE_COUNT; p++) {
+    ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(phase_colors[p]), "%s", FrameTimes::phase_name(p));
+    ImGui::SameLine();
+  }
+  ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(other_color), "other");
+  ImGui::SameLine();
+  ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(gpu_color), "gpu");
+  ImGui::SameLine();
+  ImGui::TextDisabled("(%.1f ms full scale)", worst);
+
+  if (ImGui::BeginTable("##percentiles", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+    ImGui::TableSetupColumn("ms");
+    ImGui::TableSetupColumn("p50");
+    ImGui::TableSetupColumn("p95");
+    ImGui::TableSetupColumn("p99");
+    ImGui::TableSetupColumn("worst");
+    ImGui::TableHeadersRow();
+    auto row = [](const char* name, float values[4], bool known) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(name);
+      for (int i = 0; i < 4; i++) {
+        ImGui::TableNextColumn();
+        if (known) {
+          ImGui::Text("%.2f", values[i]);
+        } else {
+          ImGui::TextUnformatted("-");
+        }
+      }
+    };
+    float values[4];
+    row("cpu", values, frame_times.percentiles([](const FrameTimes::Sample& s) { return s.cpu_ms; }, values));
+    for (int p = 0; p < FrameTimes::PHASE_COUNT; p++) {
+      bool known = frame_times.percentiles([p](const FrameTimes::Sample& s) { return s.phase_ms[p]; }, values);
+      row(FrameTimes::phase_name(p), values, known);
+    }
+    row("gpu", values, frame_times.percentiles([](const FrameTimes::Sample& s) { return s.gpu_ms; }, values));
+    ImGui::EndTable();
+  }
+
+  if (ImGui::Button("save frame times")) {
+    char name[64];
+    std::time_t t = std::time(nullptr);
+    std::strftime(name, sizeof(name), "frames-%Y%m%d-%H%M%S.csv", std::localtime(&t));
+    frame_times.write_csv(name);
+  }
+}
+
 void window_close_callback(GLFWwindow *window) {
   if (!g_state.isconfirm_exit) {
     g_state.isconfirm_exit = true;
@@ -252,9 +1973,22 @@ int main() {
   Texture base_texture;
   base_texture.create_RGBA8(g_state.present_w, g_state.present_h);
 
-  GLuint display_prog = make_fullscreen_program("shaders/present.frag");
+  GLuint display_prog = get_fullscreen_program("shaders/present.frag");
+  enum PresentUniform {
+    PRESENT_TEX, PRESENT_XFORM, PRESENT_CANVAS_SIZE, PRESENT_CHECKER_SIZE, PRESENT_SRC_XFORM,
+    PRESENT_SRC_CLIP, PRESENT_HAS_PREVIEW, PRESENT_PREVIEW, PRESENT_REFINED_RECT
+  };
+  UniformSlots present_uniforms;
+  present_uniforms.resolve(display_prog, "", {
+    "uTex", "uXform", "uCanvasSize", "uCheckerSize", "uSrcXform",
+    "uSrcClip", "uHasPreview", "uPreview", "uRefinedRect"
+  });
+
+  FrameTimes frame_times;
+  GpuTimers& gpu_timers = g_state.gpu_timers;
 
   while (!glfwWindowShouldClose(window)) {
+    double frame_t0 = Tracer::now_us();
     glfwPollEvents();
 
     ImGui_ImplOpenGL3_NewFrame();
@@ -310,15 +2044,8 @@ int main() {
 
     // --- render
 
-    GLuint final_tex = base_texture.id;
-    if (g_state.output_node_id >= 0) {
-      final_tex = g_state.eval(g_state.output_node_id);
-    } else {
-      // fallback to default size
-      g_state.set_present_fbo_size(512, 512);
-    }
-
     // scale to fit window instead of stretch
+    // (uses the output size from the last frame, the view is set before eval)
     float aspect_canvas = (float)g_state.present_w / (float)g_state.present_h;
     float aspect_window = (float)io.DisplaySize.x / (float)io.DisplaySize.y;
 
@@ -341,18 +2068,66 @@ int main() {
     M = amat3_mul(M, amat3_transform(-offx, -offy));
     M = amat3_mul(M, amat3_scale(1.0f/sx, 1.0f/sy));
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, display_w, display_h);
-    glUseProgram(display_prog);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, final_tex);
-    glUniform1i(glGetUniformLocation(display_prog, "uTex"), 0);
-    glUniformMatrix3fv(glGetUniformLocation(display_prog, "uXform"), 1, GL_TRUE, M.m);
-    glUniform2f(glGetUniformLocation(display_prog, "uCanvasSize"), (float)g_state.present_w, (float)g_state.present_h);
-    glUniform1f(glGetUniformLocation(display_prog, "uCheckerSize"), 32.0f * zoom);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    // the active item is still last frame's until widgets run again, so the
+    // full resolution pass starts the frame after the mouse is released
+    if (!ImGui::IsAnyItemActive()) {
+      g_state.dragging = false;
+    }
+    float proxy = g_state.dragging ? g_state.proxy_scale : 1.0f;
+
+    // only the visible part of the output is rendered, at screen resolution
+    g_state.set_view(
+      uvrect_transform(M, UVRect{}),
+      proxy * std::max(
+        (float)display_w * sx / (float)g_state.present_w,
+        (float)display_h * sy / (float)g_state.present_h
+      )
+    );
+
+    g_state.tune_budget(io.DeltaTime);
+    GLuint final_tex = base_texture.id;
+    double eval_t0 = Tracer::now_us();
+    if (g_state.output_node_id >= 0) {
+      final_tex = g_state.eval(g_state.output_node_id);
+    } else {
+      // fallback to default size
+      g_state.set_present_fbo_size(512, 512);
+    }
+
+    tracer().span("eval", eval_t0);
+    frame_times.add(FrameTimes::PHASE_EVAL, eval_t0);
+
+    double present_t0 = Tracer::now_us();
+    gpu_timers.begin(-1, "present");
+    gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    gl_viewport(0, 0, display_w, display_h);
+    gl_use_program(display_prog);
+    gl_active_texture(GL_TEXTURE0);
+    gl_bind_texture(GL_TEXTURE_2D, final_tex);
+    gl_uniform1i(present_uniforms, PRESENT_TEX, 0);
+    gl_uniform_matrix3fv(present_uniforms, PRESENT_XFORM, GL_TRUE, M.m);
+    gl_uniform2f(present_uniforms, PRESENT_CANVAS_SIZE, (float)g_state.present_w, (float)g_state.present_h);
+    gl_uniform1f(present_uniforms, PRESENT_CHECKER_SIZE, 32.0f * zoom);
+    UVXform src_xform = g_state.output_node_id >= 0 ? g_state.present_xform : UVXform{};
+    gl_uniform_matrix3fv(present_uniforms, PRESENT_SRC_XFORM, GL_TRUE, src_xform.matrix.m);
+    gl_uniform_matrix3fv(present_uniforms, PRESENT_SRC_CLIP, GL_TRUE, src_xform.clip.m);
+    bool show_preview = g_state.output_node_id >= 0 && g_state.show_preview();
+    gl_uniform1i(present_uniforms, PRESENT_HAS_PREVIEW, show_preview);
+    if (show_preview) {
+      UVRect refined = g_state.refined_roi();
+      gl_active_texture(GL_TEXTURE1);
+      gl_bind_texture(GL_TEXTURE_2D, g_state.preview_fbo.tex.id);
+      gl_active_texture(GL_TEXTURE0);
+      gl_uniform1i(present_uniforms, PRESENT_PREVIEW, 1);
+      gl_uniform4f(present_uniforms, PRESENT_REFINED_RECT, refined.x0, refined.y0, refined.x1, refined.y1);
+    }
+    gl_draw_fullscreen();
+    gpu_timers.end();
+    tracer().span("present", present_t0);
+    frame_times.add(FrameTimes::PHASE_PRESENT, present_t0);
 
     // --- ui
+    double ui_t0 = Tracer::now_us();
 
     // set font
     ImGui::PushFont(io.Fonts->Fonts[0]);
@@ -415,41 +2190,43 @@ int main() {
         if (ImGui::BeginPopup("add op")) {
           const ImVec2 click_pos = ImGui::GetMousePosOnOpeningCurrentPopup();
 
-          #define CHECK_PROG_ID_AND_PUSH(op) \
-            if (!op.prog_id) { \
-              LOG_ERROR("Failed to create shader for %s", op.get_type_name()); \
-            } else { \
-              g_state.register_op(std::make_unique<decltype(op)>(op)); \
-              ImNodes::SetNodeScreenSpacePos( \
-                g_state.next_op_id - 1, \
-                click_pos \
-              ); \
+          // programs come from program_registry(), so this only compiles
+          // the first op of a type
+          auto push_op = [&](std::unique_ptr<Op> op) {
+            if (!op->prog_id && !op->always_constant()) {
+              LOG_ERROR("Failed to create shader for %s", op->get_type_name());
+              gpu_resources().adopt(GpuResources::OWNER_GONE);
+            } else {
+              int id = g_state.register_op(std::move(op));
+              if (id >= 0) {
+                ImNodes::SetNodeScreenSpacePos(id, click_pos);
+              }
             }
+          };
 
-          bool over_limit = g_state.ops.size() >= 65535;
-          if (ImGui::MenuItem("const/color") && !over_limit) {
-            OpConstColor op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("const/color")) {
+            push_op(std::make_unique<OpConstColor>());
           }
-          if (ImGui::MenuItem("const/image") && !over_limit) {
-            OpConstImage op(""); CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("const/image")) {
+            push_op(std::make_unique<OpConstImage>(""));
           }
-          if (ImGui::MenuItem("gen/composite") && !over_limit) {
-            OpGenComposite op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("gen/composite")) {
+            push_op(std::make_unique<OpGenComposite>());
           }
-          if (ImGui::MenuItem("gen/transform") && !over_limit) {
-            OpGenTransform op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("gen/transform")) {
+            push_op(std::make_unique<OpGenTransform>());
           }
-          if (ImGui::MenuItem("gen/grade") && !over_limit) {
-            OpGenGrade op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("gen/grade")) {
+            push_op(std::make_unique<OpGenGrade>());
           }
-          if (ImGui::MenuItem("gen/grayscale") && !over_limit) {
-            OpGenGrayscale op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("gen/grayscale")) {
+            push_op(std::make_unique<OpGenGrayscale>());
           }
-          if (ImGui::MenuItem("eff/blur") && !over_limit) {
-            OpEffBlur op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("eff/blur")) {
+            push_op(std::make_unique<OpEffBlur>());
           }
-          if (ImGui::MenuItem("eff/dither") && !over_limit) {
-            OpEffDither op; CHECK_PROG_ID_AND_PUSH(op);
+          if (ImGui::MenuItem("eff/dither")) {
+            push_op(std::make_unique<OpEffDither>());
           }
           ImGui::EndPopup();
         }
@@ -457,32 +2234,25 @@ int main() {
         ImGui::PopStyleVar();
       }
 
+      GpuTimers& timers = g_state.gpu_timers;
+      double max_gpu_ms = timers.max_avg_ms();
+
       for (size_t i = 0; i < g_state.ops.size(); i++) {
         Op &op = *(g_state.ops[i]);
         size_t input_count = op.input_names.size();
 
-        // node rendering
-        // we can deterministically generate attribute/link ids based on op.id
-        // by convention:
-        //   [0000 0000 0000 0000 0000 0000 0000 0000] (rightmost are LSB)
-        //    unused  | |       | |-----------------| unique per attribute (op.id)
-        //            | |-------| input/output attribute ID (max of 255 per op)
-        //            | input/output
-        // this means that we can have up to 65535 ops before collisions occur
-        // we do this because we don't want to clutter Op's struct with extra IDs
-        // for input/output attribute IDs
-        // let's see if this will scale well enough...
-
-        #define U 16 // bits for op id
-        // decode node ID by masking out lower U bits and &ing with the ID
-        #define DECODE_NODE_ID(op_id) (op_id & ((1u << U) - 1u))
-        // decode attribute ID by shifting right U bits and &ing with 0xFF (8 bits)
-        #define DECODE_ATTR_ID(op_id) ((op_id >> U) & 0xFFu)
-        #define DECODE_IO(op_id) ((op_id >> (U + 8)) & 0x1u) // 0=input, 1=output
-
-        #define ENCODE_ATTR_ID(op_id, attr_id, is_output) \
-          (op_id | ((attr_id & 0xFFu) << U) | ((is_output & 0x1u) << (U + 8)))
+        // the ops taking the most gpu time get a hotter title bar
+        const GpuTimers::OpTiming* timing = timers.get(op.id);
+        float heat = timing && max_gpu_ms > 0.0 ? (float)(timing->avg_ms / max_gpu_ms) : 0.0f;
+        bool hot = timing && heat >= 0.5f && timing->avg_ms >= 0.1;
+        if (hot) {
+          int r = 110 + (int)(130.0f * heat);
+          ImNodes::PushColorStyle(ImNodesCol_TitleBar, IM_COL32(r, 60, 40, 255));
+          ImNodes::PushColorStyle(ImNodesCol_TitleBarHovered, IM_COL32(r + 15, 80, 60, 255));
+          ImNodes::PushColorStyle(ImNodesCol_TitleBarSelected, IM_COL32(r + 15, 80, 60, 255));
+        }
 
+        // node rendering
         {
           ImNodes::BeginNode(op.id);
 
@@ -493,38 +2263,60 @@ int main() {
           ImNodes::EndNodeTitleBar();
 
           for (size_t j = 0; j < input_count; j++) {
-            ImNodes::BeginInputAttribute(ENCODE_ATTR_ID(op.id, (int)j, 0));
+            ImNodes::BeginInputAttribute(input_attr_id(op, (int)j));
             const char *label = op.input_names[j];
             ImGui::TextUnformatted(label);
 
             ImNodes::EndInputAttribute();
           }
 
-          ImNodes::BeginOutputAttribute(ENCODE_ATTR_ID(op.id, 0, 1));
+          ImNodes::BeginOutputAttribute(output_attr_id(op));
           ImGui::TextUnformatted("output");
           ImNodes::EndOutputAttribute();
+          // from the last metadata pass, see State::prepare_step
+          ImGui::Text("%d x %d%s", op.out_w, op.out_h, uvrect_is_empty(op.data_window) ? ", empty" : "");
+          if (timing) {
+            ImGui::Text("gpu: %.2f ms", timing->avg_ms);
+          }
 
           ImGui::PushItemWidth(200.0f);
 
           separator(100.0f, 10.0f);
-          op.ui(i);
+          bool changed = op.ui(op.id);
           separator(100.0f, 10.0f);
 
-          ImGui::Checkbox(format_id("use input size", i), &op.use_input_size);
+          // both decide whether the op can be fused, see State::fuse_prev
+          bool plan_changed = false;
+          plan_changed |= ImGui::Checkbox(format_id("bypass", op.id), &op.bypass);
+          plan_changed |= ImGui::Checkbox(format_id("use input size", op.id), &op.use_input_size);
+          if (plan_changed) {
+            g_state.touch(&op);
+            changed = true;
+          }
+          if (g_state.low_vram) {
+            ImGui::Checkbox(format_id("keep result", op.id), &op.pinned);
+          }
           if (!op.use_input_size) {
-            ImGui::InputInt(format_id("width", i), &op.out_w);
-            ImGui::InputInt(format_id("height", i), &op.out_h);
+            changed |= ImGui::InputInt(format_id("width", op.id), &op.out_w);
+            changed |= ImGui::InputInt(format_id("height", op.id), &op.out_h);
             // clamp
             if (op.out_w < 1) op.out_w = 1;
             if (op.out_h < 1) op.out_h = 1;
             const char* filter_items[] = { "nearest", "linear" };
             static int current_filter_idx = 0;
-            if (ImGui::Combo(format_id("filter mode", i), &current_filter_idx, filter_items, IM_ARRAYSIZE(filter_items))) {
+            if (ImGui::Combo(format_id("filter mode", op.id), &current_filter_idx, filter_items, IM_ARRAYSIZE(filter_items))) {
               if (current_filter_idx == 0) {
                 op.filter_mode = GL_NEAREST;
               } else {
                 op.filter_mode = GL_LINEAR;
               }
+              changed = true;
+            }
+          }
+          if (changed) {
+            g_state.invalidate(op.id);
+            if (ImGui::IsAnyItemActive()) {
+              g_state.dragging = true;
             }
           }
 
@@ -533,7 +2325,7 @@ int main() {
             ImGui::Button("set as output");
             ImGui::EndDisabled();
           } else {
-            if (ImGui::Button(format_id("set as output", i))) {
+            if (ImGui::Button(format_id("set as output", op.id))) {
               g_state.output_node_id = g_state.ops[i]->id;
               LOG_INFO("Set operation %d as output node", g_state.ops[i]->id);
             }
@@ -543,6 +2335,11 @@ int main() {
 
           ImNodes::EndNode();
         }
+        if (hot) {
+          ImNodes::PopColorStyle();
+          ImNodes::PopColorStyle();
+          ImNodes::PopColorStyle();
+        }
       } // for each op
 
       for (const Link& link : g_state.links) {
@@ -555,45 +2352,30 @@ int main() {
       {
         int start_attr, end_attr;
         if (ImNodes::IsLinkCreated(&start_attr, &end_attr)) {
-          int start_op_id = DECODE_NODE_ID(start_attr);
-          int end_op_id = DECODE_NODE_ID(end_attr);
-          int end_input_idx = DECODE_ATTR_ID(end_attr);
-
-          std::unique_ptr<Op>& end_op = g_state.get_op_by_id(end_op_id);
-          if (end_op) {
-            // If there's an existing link targeting the same input, remove it first.
-            auto it = std::find_if(
-              g_state.links.begin(),
-              g_state.links.end(),
-              [end_attr](const Link& l) { return l.end_attr == end_attr; }
-            );
-            if (it != g_state.links.end()) {
-              int old_link_id = it->id;
-              LOG_INFO("Replacing existing link id=%d for input attr=%d", old_link_id, end_attr);
-
-              // Clear the corresponding input_id in the end op of the old link
-              int old_end_attr = it->end_attr;
-              int old_end_op_id = DECODE_NODE_ID(old_end_attr);
-              int old_end_input_idx = DECODE_ATTR_ID(old_end_attr);
-              std::unique_ptr<Op>& old_end_op = g_state.get_op_by_id(old_end_op_id);
-              if (old_end_op) {
-                if (static_cast<size_t>(old_end_input_idx) < old_end_op->input_names.size()) {
-              old_end_op->input_ids[old_end_input_idx] = -1;
-                }
-              }
-
-              g_state.remove_link(old_link_id);
-            }
-
-            // Attach the new link
-            if (static_cast<size_t>(end_input_idx) < end_op->input_names.size()) {
-              end_op->input_ids[end_input_idx] = start_op_id;
-              g_state.create_link(start_attr, end_attr);
-              LOG_INFO("Created link from op %d to input index %d of op %d",
-                  start_op_id, end_input_idx, end_op_id);
-            } else {
+          const AttrRef* start_ref = g_state.get_attr(start_attr);
+          const AttrRef* end_ref = g_state.get_attr(end_attr);
+          int start_op_id = start_ref && start_ref->index == ATTR_OUTPUT ? start_ref->op_id : -1;
+          int end_op_id = end_ref ? end_ref->op_id : -1;
+          int end_input_idx = end_ref ? end_ref->index : -1;
+
+          Op* end_op = g_state.get_op_by_id(end_op_id);
+          if (end_op && g_state.get_op_by_id(start_op_id)) {
+            if (end_input_idx < 0 || static_cast<size_t>(end_input_idx) >= end_op->input_names.size()) {
               LOG_WARN("Input index %d out of range for op id=%d",
                   end_input_idx, end_op_id);
+            } else {
+              // an existing link targeting the same input is replaced
+              int old_link_id = end_op->input_links[end_input_idx];
+              if (g_state.set_input(end_op_id, end_input_idx, start_op_id, start_attr, end_attr) < 0) {
+                LOG_WARN("Rejected link from op %d to op %d, it would create a cycle",
+                    start_op_id, end_op_id);
+              } else {
+                if (old_link_id != -1) {
+                  LOG_INFO("Replaced existing link id=%d for input attr=%d", old_link_id, end_attr);
+                }
+                LOG_INFO("Created link from op %d to input index %d of op %d",
+                    start_op_id, end_input_idx, end_op_id);
+              }
             }
           }
         }
@@ -608,30 +2390,9 @@ int main() {
           ImNodes::GetSelectedLinks(selected_links.data());
           for (const int link_id : selected_links) {
             LOG_INFO("Deleting link id=%d", link_id);
-            // find which op's input_ids to clear
-            auto it = std::find_if(
-              g_state.links.begin(),
-              g_state.links.end(),
-              [link_id](const Link& link) { return link.id == link_id; }
-            );
-            if (it != g_state.links.end()) {
-              // clear the corresponding input_id in the end op
-              int end_attr = it->end_attr;
-              int end_op_id = DECODE_NODE_ID(end_attr);
-              int end_input_idx = DECODE_ATTR_ID(end_attr);
-
-              std::unique_ptr<Op>& end_op = g_state.get_op_by_id(end_op_id);
-              if (end_op) {
-                LOG_INFO("Clearing input index %d of op id=%d",
-                        end_input_idx, end_op_id);
-                if (static_cast<size_t>(end_input_idx) < end_op->input_names.size()) {
-                  end_op->input_ids[end_input_idx] = -1;
-                }
-              }
-            } else {
+            if (!g_state.get_link_by_id(link_id)) {
               LOG_WARN("Link id=%d not found in state", link_id);
             }
-
             g_state.remove_link(link_id);
           }
         }
@@ -646,20 +2407,7 @@ int main() {
           ImNodes::GetSelectedNodes(selected_nodes.data());
           for (const int node_id : selected_nodes) {
             LOG_INFO("Deleting node id=%d", node_id);
-            // remove associated links
-            g_state.links.erase(
-              std::remove_if(
-                g_state.links.begin(),
-                g_state.links.end(),
-                [node_id](const Link& link) {
-                  int start_op_id = DECODE_NODE_ID(link.start_attr);
-                  int end_op_id = DECODE_NODE_ID(link.end_attr);
-                  return start_op_id == node_id || end_op_id == node_id;
-                }
-              ),
-              g_state.links.end()
-            );
-            // remove the node
+            // remove the node along with its links
             g_state.unregister_op(node_id);
             // clear output node if needed
             if (g_state.output_node_id == node_id) {
@@ -677,21 +2425,213 @@ int main() {
 
       ImGui::Text("output: %d x %d", g_state.present_w, g_state.present_h);
       ImGui::Text("output tex id: %d", final_tex);
-      ImGui::Text("mem: %s", format_bytes(get_mem_usage()).c_str());
+      MemStats mem = get_mem_stats();
+      ImGui::Text("mem: %s rss, %s pss, %s private",
+        format_bytes(mem.rss).c_str(), format_bytes(mem.pss).c_str(), format_bytes(mem.private_bytes).c_str());
       ImGui::Text("fps: %.1f", io.Framerate);
+      frame_time_panel(frame_times);
       ImGui::Text("zoom: %.2f%%", g_state.zoom_factor * 100.0f);
       ImGui::Text("pan: (%.1f, %.1f)", g_state.pan_x, g_state.pan_y);
+      ImGui::Text("render scale: %.3f%s", g_state.view_scale, g_state.dragging ? " (proxy)" : "");
+
+      ImGui::Text("plan: %zu ops, %d fused, %d deferred, %d constant",
+        g_state.plan.size(), g_state.plan_fused_ops, g_state.plan_deferred_ops, g_state.plan_constant_ops);
+      ImGui::Checkbox("progressive", &g_state.progressive);
+      ImGui::Text("pixel budget: %.1f Mpx/frame", g_state.pixel_budget / 1e6);
+      if (g_state.show_preview()) {
+        const UVRect& roi = g_state.refine_roi;
+        ImGui::Text("refining: %.0f%%", 100.0f * (g_state.refine_y - roi.y0) / (roi.y1 - roi.y0));
+      }
+
+      const char* proxy_items[] = { "full", "1/2", "1/4", "1/8" };
+      int proxy_idx = (int)std::round(-std::log2(g_state.proxy_scale));
+      if (ImGui::Combo("drag proxy", &proxy_idx, proxy_items, IM_ARRAYSIZE(proxy_items))) {
+        g_state.proxy_scale = std::exp2(-(float)proxy_idx);
+      }
+
+      ImGui::Separator();
+
+      Tracer& trace = tracer();
+      if (trace.recording) {
+        ImGui::Text("recording trace...");
+      } else if (trace.flush_frames > 0) {
+        ImGui::Text("writing trace...");
+      } else if (ImGui::Button("record trace")) {
+        trace.start();
+      }
+      // gl calls in the last frame, in total and for each op making any
+      GlCallStats& calls = gl_call_stats();
+      GlCounters total = calls.last_frame_total();
+      ImGui::Text("gl: %zu draws, %zu programs, %zu textures, %zu fbos, %zu clears, %zu uniforms, %zu lookups, %s uploaded",
+        total.draws + total.blits, total.program_switches, total.texture_binds, total.fbo_binds,
+        total.clears, total.uniform_uploads, total.uniform_lookups, format_bytes(total.upload_bytes).c_str());
+      ImGui::Text("skipped: %zu redundant state changes, %zu clears a pass overwrote, %zu unchanged uniforms",
+        total.skipped_binds, total.skipped_clears, total.skipped_uniforms);
+      if (ImGui::BeginTable("##gl calls", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+        const char* columns[] = { "op", "draws", "programs", "textures", "fbos", "clears", "uniforms", "skipped" };
+        for (const char* column : columns) {
+          ImGui::TableSetupColumn(column);
+        }
+        ImGui::TableHeadersRow();
+        for (const auto& [id, c] : calls.last_frame) {
+          const Op* counted = g_state.get_op_by_id(id);
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          if (counted) {
+            ImGui::Text("%s #%d", counted->get_type_name(), id);
+          } else {
+            ImGui::TextUnformatted("other");
+          }
+          const size_t values[] = {
+            c.draws + c.blits, c.program_switches, c.texture_binds, c.fbo_binds, c.clears, c.uniform_uploads,
+            c.skipped_binds + c.skipped_clears + c.skipped_uniforms
+          };
+          for (size_t value : values) {
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", value);
+          }
+        }
+        ImGui::EndTable();
+      }
+
+      ImGui::Checkbox("gpu timing", &timers.enabled);
+      ImGui::Text("gpu: %.2f ms/frame", timers.frame_gpu_ms);
+      std::vector<std::pair<double, const Op*>> by_time;
+      for (const auto& [id, t] : timers.timings) {
+        const Op* timed = g_state.get_op_by_id(id);
+        if (timed && t.runs > 0) {
+          by_time.push_back({ t.avg_ms, timed });
+        }
+      }
+      std::sort(by_time.begin(), by_time.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+      for (const auto& [avg_ms, timed] : by_time) {
+        ImGui::Text("  %.2f ms (last %.2f)  %s #%d",
+          avg_ms, timers.get(timed->id)->last_ms, timed->get_type_name(), timed->id);
+      }
+
+      ImGui::Separator();
+
+      // vram per op: the result it holds plus what it created itself
+      GpuResources& resources = gpu_resources();
+      ImGui::Text("vram: %s in %zu textures, %zu framebuffers, %zu programs",
+        format_bytes(resources.bytes[(int)GpuResourceKind::Texture]).c_str(),
+        resources.count[(int)GpuResourceKind::Texture],
+        resources.count[(int)GpuResourceKind::Framebuffer],
+        resources.count[(int)GpuResourceKind::Program]);
+      for (size_t i = 0; i < g_state.ops.size(); i++) {
+        const Op& op = *(g_state.ops[i]);
+        size_t result_bytes = op.layer_fbo.size_bytes();
+        size_t owned_bytes = resources.owned_bytes(op.id);
+        if (result_bytes + owned_bytes > 0) {
+          ImGui::Text("  %s  %s #%d",
+            format_bytes(result_bytes + owned_bytes).c_str(), op.get_type_name(), op.id);
+        }
+      }
+      // left behind by removed ops, or created by ops that never got added
+      const GpuResources::Owned* leaked[] = {
+        resources.owned(GpuResources::OWNER_GONE),
+        resources.owned(GpuResources::OWNER_NEW_OP),
+      };
+      size_t leaked_count = 0;
+      size_t leaked_bytes = 0;
+      for (const GpuResources::Owned* owned : leaked) {
+        if (owned) {
+          leaked_count += owned->keys.size();
+          leaked_bytes += owned->bytes;
+        }
+      }
+      if (leaked_count > 0) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "leaked: %zu objects, %s",
+          leaked_count, format_bytes(leaked_bytes).c_str());
+        if (ImGui::IsItemHovered()) {
+          ImGui::BeginTooltip();
+          for (const GpuResources::Owned* owned : leaked) {
+            if (!owned) {
+              continue;
+            }
+            for (const GpuResources::Key& key : owned->keys) {
+              const GpuResources::Entry& entry = resources.entries.at(key);
+              ImGui::Text("%s %u (%s), %s", gpu_resource_kind_name(entry.kind), key.second,
+                entry.label, format_bytes(entry.bytes).c_str());
+            }
+          }
+          ImGui::EndTooltip();
+        }
+      }
+      if (resources.unknown_deletes > 0) {
+        ImGui::Text("untracked deletes: %zu", resources.unknown_deletes);
+      }
+
+      ImGui::Separator();
+
+      ResultCache& cache = g_state.cache;
+      ImGui::Text("cache: %zu results, %s / %s",
+        cache.lru.size(),
+        format_bytes(cache.used_bytes).c_str(),
+        format_bytes(cache.budget_bytes).c_str());
+      ImGui::Text("cache hits: %zu, misses: %zu, evictions: %zu",
+        cache.hits, cache.misses, cache.evictions);
+      int budget_mb = (int)(cache.budget_bytes >> 20);
+      if (ImGui::SliderInt("cache budget (MB)", &budget_mb, 0, 8192)) {
+        cache.budget_bytes = (size_t)budget_mb << 20;
+        cache.trim(cache.budget_bytes);
+      }
+
+      FBOPool& pool = fbo_pool();
+      // edits only patch the plan, which keeps the order valid but not
+      // necessarily memory-aware, so lay it out again
+      if (ImGui::Checkbox("low vram", &g_state.low_vram) && g_state.low_vram) {
+        g_state.plan_dirty = true;
+      }
+      ImGui::Text("targets: %zu live, %s",
+        pool.live_count, format_bytes(pool.live_bytes).c_str());
+      ImGui::Text("pool: %zu idle, %s / %s, peak %s",
+        pool.idle_count,
+        format_bytes(pool.idle_bytes).c_str(),
+        format_bytes(pool.idle_budget_bytes).c_str(),
+        format_bytes(pool.peak_bytes).c_str());
+      ImGui::Text("pool allocations: %zu, reuses: %zu, frees: %zu",
+        pool.allocations, pool.reuses, pool.frees);
+      int pool_mb = (int)(pool.idle_budget_bytes >> 20);
+      if (ImGui::SliderInt("pool budget (MB)", &pool_mb, 0, 4096)) {
+        pool.idle_budget_bytes = (size_t)pool_mb << 20;
+        pool.trim(pool.idle_budget_bytes);
+      }
       ImGui::End();
     } // if editor open 
 
     ImGui::PopFont();
     ImGui::Render();
+    tracer().span("ui", ui_t0);
 
+    double draw_t0 = Tracer::now_us();
+    gpu_timers.begin(-1, "ui draw");
+    // imgui's backend sets gl state behind the wrappers' back, see gl_calls.hpp
+    gl_state_reset();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    gl_state_reset();
+    gpu_timers.end();
+    tracer().span("ui draw", draw_t0);
+    frame_times.add(FrameTimes::PHASE_UI, ui_t0);
 
+    double swap_t0 = Tracer::now_us();
     glfwSwapBuffers(window);
+    tracer().span("swap", swap_t0);
+    frame_times.add(FrameTimes::PHASE_SWAP, swap_t0);
+
+    fbo_pool().end_frame();
+    gl_call_stats().end_frame();
+    frame_times.end_frame(frame_t0, gpu_timers.frame);
+    gpu_timers.collect();
+    for (const auto& [frame, ms] : gpu_timers.finished_frames) {
+      frame_times.set_gpu(frame, ms);
+    }
+    gpu_timers.finished_frames.clear();
+    tracer().span("frame", frame_t0);
+    tracer().end_frame();
   }
 
+  program_registry().destroy();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImNodes::DestroyContext();
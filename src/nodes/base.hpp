@@ -1,8 +1,12 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cassert>
 #include <vector>
+#include "../fusion.hpp"
+#include "../pool.hpp"
 #include "../shader.hpp"
+#include "../trace.hpp"
 #include "../utils.hpp"
 
 #define format_id(str, id) std::format("{}##{}", str, id).c_str()
@@ -27,19 +31,80 @@ enum class MixType {
 struct Op {
   // graph-related fields
   int id = -1; // assigned by state
+  int attr_base = -1; // first ImNodes attribute id of this op, assigned by state
   std::vector<const char*> input_names; // list of input names
   std::vector<int> input_ids; // ids of input ops
-  bool dirty = true; // whether the op needs to be re-evaluated
+  std::vector<int> input_links; // id of the link feeding each input, -1 if unconnected
+  std::vector<int> output_links; // ids of links reading this op's output
+  bool dirty = true; // whether the op needs to be re-evaluated, see State::invalidate
   FBO layer_fbo; // op result stored here
+  // intermediate targets apply renders through, each the size of the op's
+  // target, by format. declared in prepare(); State::allocate_targets
+  // hands them out in scratch_fbos and takes them back once the op has run
+  std::vector<GLenum> scratch_formats;
+  std::vector<FBO> scratch_fbos;
+  GLuint out_tex = 0; // texture consumers read, layer_fbo's or an aliased input's
+  UVXform out_xform; // how consumers sample out_tex, see State::prepare_step
+  std::vector<UVXform> input_xforms; // out_xform of each input, set by state before apply
+  bool is_constant = false; // output is constant_value everywhere, see fold_constant
+  float constant_value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  std::vector<const float*> input_constants; // constant_value of each input or null, set by state
+  int plan_index = -1; // position in the compiled plan, -1 if not in it, assigned by state
+  int plan_refs = 0; // see State::plan_ref
+  bool plan_touched = false; // see State::touch
+  int topo_ord = 0; // inputs always have a lower topo_ord, maintained by state
+  uint64_t result_key = 0; // content hash of the result in layer_fbo, 0 if none
+  uint32_t visit_mark = 0; // scratch mark for graph walks
+  int live_need = 0; // scratch for State::compile_plan
+  bool pinned = false; // keep the result even in low vram mode
 
   // texture fields
   GLuint prog_id = 0;
+  // prog_id's uniforms when it runs a pointwise snippet, see apply_pointwise
+  UniformSlots input_slots;
+  UniformSlots pointwise_slots;
   bool bypass = false;
   int out_w = 512;
   int out_h = 512;
   bool use_input_size = true;
-  // TODO you have to resize to see the filter_mode update
   GLenum filter_mode = GL_NEAREST;
+  GLenum out_format = GL_RGBA8; // internal format of layer_fbo
+  // part of the output that can be non-transparent, set by state before
+  // rendering (see output_window)
+  UVRect data_window;
+
+  // region of interest, set by state before apply. out_w x out_h is the
+  // logical size; the result is rendered at render_scale of it, and only the
+  // pixels covering render_roi are shaded
+  UVRect render_roi;
+  float render_scale = 1.0f;
+  // what layer_fbo currently holds, owned by state
+  UVRect valid_roi = uvrect_empty();
+  float valid_scale = 0.0f;
+
+  // physical size of the result texture
+  int target_w() const { return std::max(1, (int)std::ceil(out_w * render_scale)); }
+  int target_h() const { return std::max(1, (int)std::ceil(out_h * render_scale)); }
+
+  // binds fbo as the render target and limits drawing to render_roi, grown
+  // by pad_x/pad_y target pixels. one extra pixel covers linear filtering
+  void begin_pass(const FBO& fbo, float pad_x = 0.0f, float pad_y = 0.0f) {
+    int w = fbo.tex.w;
+    int h = fbo.tex.h;
+    int x0 = std::max(0, (int)std::floor(render_roi.x0 * w - pad_x) - 1);
+    int y0 = std::max(0, (int)std::floor(render_roi.y0 * h - pad_y) - 1);
+    int x1 = std::min(w, (int)std::ceil(render_roi.x1 * w + pad_x) + 1);
+    int y1 = std::min(h, (int)std::ceil(render_roi.y1 * h + pad_y) + 1);
+
+    gl_bind_framebuffer(GL_FRAMEBUFFER, fbo.fbo_id);
+    gl_viewport(0, 0, w, h);
+    gl_scissor_test(true);
+    gl_scissor(x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0));
+    gl_clear_color(0.0f, 0.0f, 0.0f, 0.0f);
+    // passes end in a gl_draw_fullscreen over the scissor box, which
+    // drops this clear; it only happens if the op bails out before drawing
+    gl_clear_lazy(GL_COLOR_BUFFER_BIT);
+  }
 
   // override output size to input size if set
   void apply_input_size(int input_w, int input_h) {
@@ -49,28 +114,88 @@ struct Op {
     }
   }
 
-  // call this before applying the op
-  void ensure_layer_fbo(int w, int h) {
-    if (layer_fbo.tex.id == 0
-      || layer_fbo.tex.w != w
-      || layer_fbo.tex.h != h
-    ) {
-      if (layer_fbo.tex.id != 0) {
-        glDeleteTextures(1, &layer_fbo.tex.id);
-        glDeleteFramebuffers(1, &layer_fbo.fbo_id);
-      }
-      layer_fbo.create(w, h);
-      layer_fbo.tex.set_filter_mode(filter_mode);
+  // targets are allocated before the plan runs (see
+  // State::allocate_targets), apply only renders into them
+  void check_targets() const {
+    assert(layer_fbo.tex.id != 0
+      && layer_fbo.tex.w == target_w()
+      && layer_fbo.tex.h == target_h()
+      && layer_fbo.tex.format == out_format);
+    assert(scratch_fbos.size() == scratch_formats.size());
+  }
+
+  // renders a pointwise op's snippet on its own, see fusion.hpp
+  void apply_pointwise(const std::vector<GLuint>& input_textures) {
+    check_targets();
+    begin_pass(layer_fbo);
+
+    if (pointwise_slots.program != prog_id) {
+      resolve_fused_inputs(input_slots, prog_id, input_ids.size());
+      pointwise_slots.resolve(prog_id, fused_stage_prefix(0), pointwise_uniforms());
+    }
+    gl_use_program(prog_id);
+    bind_fused_inputs(input_slots, input_textures, input_xforms, input_constants);
+    set_pointwise_uniforms(pointwise_slots);
+
+    gl_draw_fullscreen();
+  }
+
+  // part of input input_idx needed to render roi of the output.
+  // pointwise ops read the same region they write
+  virtual UVRect input_roi(const UVRect& roi, int /* input_idx */) const { return roi; }
+
+  // metadata pass, run by state before the op's key is computed and before
+  // anything renders. ops whose size or content depends on data they load
+  // (re)load it here and set out_w/out_h, see State::prepare_step
+  virtual void prepare() {}
+
+  // data_window of the output from each input's, in output uv. an empty
+  // window means the output is transparent everywhere
+  virtual UVRect output_window(const std::vector<UVRect>& /* input_windows */) const { return UVRect{}; }
+
+  // hashes everything besides the inputs that the result depends on
+  uint64_t hash_content() const {
+    uint64_t h = hash_str(HASH_SEED, get_type_name());
+    h = hash_value(h, use_input_size);
+    if (!use_input_size) {
+      h = hash_value(h, out_w);
+      h = hash_value(h, out_h);
     }
+    h = hash_value(h, filter_mode);
+    h = hash_value(h, out_format);
+    return hash_params(h);
   }
 
+  // what the constructor creates belongs to the op, see GpuResources
+  Op() { gpu_resources().owner = GpuResources::OWNER_NEW_OP; }
   virtual ~Op() = default;
   virtual char const* get_type_name() const = 0;
-  virtual void apply(
-    const std::vector<GLuint>&, /* input_textures */
-    int /* input_w */,
-    int /* input_h */
-  ) {}
+  // folds the op's own parameters into h
+  virtual uint64_t hash_params(uint64_t h) const { return h; }
+  // renders into layer_fbo, see check_targets
+  virtual void apply(const std::vector<GLuint>& /* input_textures */) {}
+  // glsl snippet of a pointwise op, null for other ops. see fusion.hpp
+  virtual const char* pointwise_source() const { return nullptr; }
+  // sets the uniforms of the op's snippet, named with prefix in place of $
+  virtual void set_pointwise_uniforms(const UniformSlots& /* u */) const {}
+  // names of the uniforms of the op's snippet without the $ prefix, in the
+  // order of the slots set_pointwise_uniforms uploads to
+  virtual std::vector<const char*> pointwise_uniforms() const { return {}; }
+  // ops whose output is constant when all their inputs are (or that have
+  // none) return true. the value is then computed on the cpu by
+  // fold_constant and nothing is rendered
+  virtual bool folds_constants() const { return false; }
+  // without inputs such an op is folded whatever the graph, so it never
+  // renders and doesn't need a program
+  bool always_constant() const { return folds_constants() && input_ids.empty(); }
+  // computes the constant output from the constant value of each input
+  virtual void fold_constant(const std::vector<const float*>& /* inputs */, float /* out */[4]) const {}
+  // ops that only resample their first input through a uv matrix set it and
+  // return true, so state can defer them into their consumers' sampling
+  virtual bool input_uv_matrix(AffineMat3& /* out */) const { return false; }
+  // whether the op samples its inputs through input_xforms
+  virtual bool samples_input_xforms() const { return pointwise_source() != nullptr; }
   // passes index or any unique id for ImGui element ids
-  virtual void ui(int) {}
+  // returns true if any parameter affecting the result was changed
+  virtual bool ui(int) { return false; }
 };
\ No newline at end of file
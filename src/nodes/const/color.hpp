@@ -6,25 +6,28 @@ struct OpConstColor : public Op {
   float color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
   char const* get_type_name() const override { return "const/color"; }
 
+  // always folded (see always_constant), so it needs no program
   OpConstColor() {
-    prog_id = make_fullscreen_program("shaders/const/color.frag");
     use_input_size = false;
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int, int) override {
-    ensure_layer_fbo(out_w, out_h);
+  bool folds_constants() const override { return true; }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glUseProgram(prog_id);
-    glUniform4fv(glGetUniformLocation(prog_id, "uColor"), 1, color);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  void fold_constant(const std::vector<const float*>&, float out[4]) const override {
+    std::memcpy(out, color, sizeof(color));
   }
 
-  void ui(int i) override {
-    ImGui::ColorPicker4(
+  uint64_t hash_params(uint64_t h) const override {
+    return hash_value(h, color);
+  }
+
+  bool ui(int i) override {
+    bool changed = false;
+    changed |= ImGui::ColorPicker4(
       format_id("color", i),
       color,
       ImGuiColorEditFlags_NoSidePreview | ImGuiColorEditFlags_NoSmallPreview
     );
+    return changed;
   }
 };
\ No newline at end of file
@@ -8,31 +8,40 @@ struct OpConstImage : public Op {
   GLuint tex_id = 0;
   int tex_w = 0, tex_h = 0;
   bool want_reload = false;
+  uint64_t load_version = 0; // distinguishes successive loads of the same path
+  UniformSlots uniforms; // uTex
   char const* get_type_name() const override { return "const/image"; }
 
   OpConstImage(std::string path) : image_path(std::move(path)) {
-    prog_id = make_fullscreen_program("shaders/const/image.frag");
+    prog_id = get_fullscreen_program("shaders/const/image.frag");
     if (!path.empty()) load_image();
     use_input_size = false;
   }
 
   ~OpConstImage() override {
-    if (tex_id) { glDeleteTextures(1, &tex_id); }
+    if (tex_id) {
+      gpu_resources().untrack(GpuResourceKind::Texture, tex_id);
+      gl_delete_texture(tex_id);
+    }
   }
 
   void load_image() {
     int w, h, n;
     stbi_set_flip_vertically_on_load(1);
+    double decode_t0 = Tracer::now_us();
     stbi_uc* pixels = stbi_load(image_path.c_str(), &w, &h, &n, 4);
+    tracer().span("image decode", decode_t0, id);
     if (!pixels) {
       LOG_ERROR("Failed to load image: %s", image_path.c_str());
       return;
     }
 
+    TraceScope trace("image upload", id);
     if (!tex_id) glGenTextures(1, &tex_id);
-    glBindTexture(GL_TEXTURE_2D, tex_id);
+    gl_bind_texture(GL_TEXTURE_2D, tex_id);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    gl_tex_image_2d(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    gpu_resources().track(GpuResourceKind::Texture, tex_id, (size_t)w * h * 4, "image");
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter_mode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter_mode);
@@ -41,30 +50,42 @@ struct OpConstImage : public Op {
 
     stbi_image_free(pixels);
     tex_w = w; tex_h = h;
+    static uint64_t next_load_version = 1;
+    load_version = next_load_version++;
     LOG_INFO("Loaded image: %s (%dx%d)", image_path.c_str(), w, h);
     want_reload = false;
   }
 
-  void apply(const std::vector<GLuint>&, int, int) override {
+  // loads before the key and size are taken, so a reload shows this frame
+  void prepare() override {
     if (want_reload) {
       load_image();
       want_reload = false;
     }
+    apply_input_size(tex_w, tex_h);
+  }
+
+  void apply(const std::vector<GLuint>&) override {
     if (tex_id == 0) { return; }
 
-    apply_input_size(tex_w, tex_h);
-    ensure_layer_fbo(out_w, out_h);
+    check_targets();
+    if (uniforms.program != prog_id) {
+      uniforms.resolve(prog_id, "", { "uTex" });
+    }
+    begin_pass(layer_fbo);
+    gl_use_program(prog_id);
+    gl_active_texture(GL_TEXTURE0);
+    gl_bind_texture(GL_TEXTURE_2D, tex_id);
+    gl_uniform1i(uniforms, 0, 0);
+    gl_draw_fullscreen();
+  }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glUseProgram(prog_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uTex"), 0);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  uint64_t hash_params(uint64_t h) const override {
+    return hash_value(h, load_version);
   }
 
-  void ui(int i) override {
+  bool ui(int i) override {
+    bool changed = false;
     char buffer[256];
     strncpy(buffer, image_path.c_str(), sizeof(buffer));
     if (ImGui::InputText(
@@ -75,6 +96,8 @@ struct OpConstImage : public Op {
     }
     if (ImGui::Button(format_id("reload", i))) {
       want_reload = true;
+      changed = true;
     }
+    return changed;
   }
 };
\ No newline at end of file
@@ -3,82 +3,115 @@
 #include "../base.hpp"
 
 struct OpEffBlur : public Op {
-  FBO temp_fbo;
   GLuint prog_v_id = 0; // use prog_id for horizontal pass
+  // both passes' programs take the same uniforms
+  enum Uniform { UNIFORM_TEX, UNIFORM_RADIUS, UNIFORM_TEXEL_SIZE };
+  UniformSlots h_uniforms;
+  UniformSlots v_uniforms;
   float radius_x = 5.0f;
   float radius_y = 5.0f;
   bool radius_uniform = true;
   char const* get_type_name() const override { return "eff/blur"; }
 
   OpEffBlur() {
-    prog_id   = make_fullscreen_program("shaders/eff/gaussian_h.frag");
-    prog_v_id = make_fullscreen_program("shaders/eff/gaussian_v.frag");
+    prog_id   = get_fullscreen_program("shaders/eff/gaussian_h.frag");
+    prog_v_id = get_fullscreen_program("shaders/eff/gaussian_v.frag");
     input_names = { "texture" };
     input_ids = { -1 };
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int input_w, int input_h) override {
+  void apply(const std::vector<GLuint>& input_textures) override {
     if (input_textures.empty()) { return; }
     GLuint base_tex_id = input_textures[0];
 
-    apply_input_size(input_w, input_h);
-    ensure_layer_fbo(out_w, out_h);
-
-    // horizontal pass
-    if (temp_fbo.tex.id == 0 || temp_fbo.tex.w != out_w || temp_fbo.tex.h != out_h) {
-      if (temp_fbo.tex.id != 0) {
-        glDeleteTextures(1, &temp_fbo.tex.id);
-        glDeleteFramebuffers(1, &temp_fbo.fbo_id);
-      }
-      temp_fbo.create(out_w, out_h);
+    check_targets();
+    if (h_uniforms.program != prog_id || v_uniforms.program != prog_v_id) {
+      h_uniforms.resolve(prog_id, "", { "uTex", "uRadius", "uTexelSize" });
+      v_uniforms.resolve(prog_v_id, "", { "uTex", "uRadius", "uTexelSize" });
     }
+    int w = target_w();
+    int h = target_h();
+
+    // radii are in output pixels, the passes run at render_scale
+    float rx = radius_x * render_scale;
+    float ry = (radius_uniform ? radius_x : radius_y) * render_scale;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, temp_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // horizontal pass into the scratch target, padded vertically for the
+    // vertical pass' taps
+    const FBO& temp_fbo = scratch_fbos[0];
 
-    glUseProgram(prog_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, base_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uTex"), 0);
-    glUniform1f(glGetUniformLocation(prog_id, "uRadius"), radius_uniform ? radius_x : radius_x);
-    glUniform2f(glGetUniformLocation(prog_id, "uTexelSize"), 1.0f / out_w, 1.0f / out_h);
+    begin_pass(temp_fbo, 0.0f, std::ceil(ry));
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    gl_use_program(prog_id);
+    gl_active_texture(GL_TEXTURE0);
+    gl_bind_texture(GL_TEXTURE_2D, base_tex_id);
+    gl_uniform1i(h_uniforms, UNIFORM_TEX, 0);
+    gl_uniform1f(h_uniforms, UNIFORM_RADIUS, rx);
+    gl_uniform2f(h_uniforms, UNIFORM_TEXEL_SIZE, 1.0f / w, 1.0f / h);
+
+    gl_draw_fullscreen();
 
     // vertical pass
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    glUseProgram(prog_v_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, temp_fbo.tex.id);
-    glUniform1i(glGetUniformLocation(prog_v_id, "uTex"), 0);
-    glUniform1f(glGetUniformLocation(prog_v_id, "uRadius"), radius_uniform ? radius_x : radius_y);
-    glUniform2f(glGetUniformLocation(prog_v_id, "uTexelSize"), 1.0f / out_w, 1.0f / out_h);
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    begin_pass(layer_fbo);
+
+    gl_use_program(prog_v_id);
+    gl_active_texture(GL_TEXTURE0);
+    gl_bind_texture(GL_TEXTURE_2D, temp_fbo.tex.id);
+    gl_uniform1i(v_uniforms, UNIFORM_TEX, 0);
+    gl_uniform1f(v_uniforms, UNIFORM_RADIUS, ry);
+    gl_uniform2f(v_uniforms, UNIFORM_TEXEL_SIZE, 1.0f / w, 1.0f / h);
+
+    gl_draw_fullscreen();
+  }
+
+  // the horizontal pass' result, at the output's precision
+  void prepare() override {
+    scratch_formats.assign(1, out_format);
+  }
+
+  // taps reach radius output pixels in each direction
+  UVRect input_roi(const UVRect& roi, int) const override {
+    float ry = radius_uniform ? radius_x : radius_y;
+    return uvrect_pad(roi, (radius_x + 1.0f) / out_w, (ry + 1.0f) / out_h);
+  }
+
+  UVRect output_window(const std::vector<UVRect>& input_windows) const override {
+    float ry = radius_uniform ? radius_x : radius_y;
+    return uvrect_clamp(uvrect_pad(input_windows[0], (radius_x + 1.0f) / out_w, (ry + 1.0f) / out_h));
+  }
+
+  // the kernel is normalized and edges clamp, so blurring a constant gives
+  // the same constant
+  bool folds_constants() const override { return true; }
+
+  void fold_constant(const std::vector<const float*>& inputs, float out[4]) const override {
+    std::memcpy(out, inputs[0], sizeof(float) * 4);
+  }
+
+  uint64_t hash_params(uint64_t h) const override {
+    h = hash_value(h, radius_x);
+    h = hash_value(h, radius_uniform ? radius_x : radius_y);
+    return h;
   }
 
-  void ui(int i) override {
-    ImGui::SliderFloat(
+  bool ui(int i) override {
+    bool changed = false;
+    changed |= ImGui::SliderFloat(
       format_id("radius x", i),
       &radius_x,
       0.0f,
       100.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("radius y", i),
       radius_uniform ? &radius_x : &radius_y,
       0.0f,
       100.0f
     );
-    ImGui::Checkbox(
+    changed |= ImGui::Checkbox(
       format_id("radius uniform", i),
       &radius_uniform
     );
+    return changed;
   }
 };
\ No newline at end of file
@@ -8,46 +8,50 @@ struct OpEffDither : public Op {
   char const* get_type_name() const override { return "eff/dither"; }
 
   OpEffDither() {
-    prog_id = make_fullscreen_program("shaders/eff/dither.frag");
     input_names = { "texture" };
     input_ids = { -1 };
+    prog_id = make_pointwise_program(pointwise_source(), 1);
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int input_w, int input_h) override {
+  void apply(const std::vector<GLuint>& input_textures) override {
     if (input_textures.empty()) { return; }
-    GLuint base_tex_id = input_textures[0];
+    apply_pointwise(input_textures);
+  }
+
+  const char* pointwise_source() const override { return "shaders/eff/dither.glsl"; }
 
-    apply_input_size(input_w, input_h);
-    ensure_layer_fbo(out_w, out_h);
+  enum Uniform { UNIFORM_VIEWPORT_SIZE, UNIFORM_STEPS, UNIFORM_DITHER_SCALE };
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+  std::vector<const char*> pointwise_uniforms() const override {
+    return { "uViewportSize", "uSteps", "uDitherScale" };
+  }
 
-    glUseProgram(prog_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, base_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uTex"), 0);
-    glUniform2f(glGetUniformLocation(prog_id, "uViewportSize"), (float)out_w, (float)out_h);
-    glUniform1f(glGetUniformLocation(prog_id, "uSteps"), steps);
-    glUniform1f(glGetUniformLocation(prog_id, "uDitherScale"), scale);
+  void set_pointwise_uniforms(const UniformSlots& u) const override {
+    gl_uniform2f(u, UNIFORM_VIEWPORT_SIZE, (float)out_w, (float)out_h);
+    gl_uniform1f(u, UNIFORM_STEPS, steps);
+    gl_uniform1f(u, UNIFORM_DITHER_SCALE, scale);
+  }
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  uint64_t hash_params(uint64_t h) const override {
+    h = hash_value(h, steps);
+    h = hash_value(h, scale);
+    return h;
   }
 
-  void ui(int i) override {
-    ImGui::SliderFloat(
+  bool ui(int i) override {
+    bool changed = false;
+    changed |= ImGui::SliderFloat(
       format_id("steps", i),
       &steps,
       1.0f,
       256.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("scale", i),
       &scale,
       0.01f,
       10.0f
     );
+    return changed;
   }
 };
\ No newline at end of file
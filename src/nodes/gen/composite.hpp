@@ -2,46 +2,90 @@
 
 #include "../base.hpp"
 
+// cpu version of composite.glsl's blend modes, for constant folding
+static float composite_sat(float x) { return std::clamp(x, 0.0f, 1.0f); }
+
+static float composite_overlay(float b, float s) {
+  return b >= 0.5f ? 1.0f - 2.0f * (1.0f - b) * (1.0f - s) : 2.0f * b * s;
+}
+
+static float composite_apply_mode(MixType mode, float b, float s) {
+  switch (mode) {
+    case MixType::MixMultiply:    return b * s;
+    case MixType::MixScreen:      return 1.0f - (1.0f - b) * (1.0f - s);
+    case MixType::MixOverlay:     return composite_overlay(b, s);
+    case MixType::MixSoftLight:
+      return composite_sat(s >= 0.5f
+        ? std::sqrt(b) * (2.0f * s - 1.0f) + 2.0f * b * (1.0f - s)
+        : 1.0f - (1.0f - b) * (1.0f - 2.0f * s));
+    case MixType::MixHardLight:   return composite_overlay(s, b);
+    case MixType::MixColorDodge:  return composite_sat(b / std::max(1e-5f, 1.0f - s));
+    case MixType::MixColorBurn:   return 1.0f - composite_sat((1.0f - b) / std::max(1e-5f, s));
+    case MixType::MixLinearDodge: return composite_sat(b + s);
+    case MixType::MixLinearBurn:  return composite_sat(b + s - 1.0f);
+    case MixType::MixLighten:     return std::max(b, s);
+    case MixType::MixDarken:      return std::min(b, s);
+    case MixType::MixDifference:  return std::fabs(b - s);
+    case MixType::MixExclusion:   return b + s - 2.0f * b * s;
+    default:                      return s;
+  }
+}
+
 struct OpGenComposite : public Op {
   MixType mix_type = MixType::MixNormal;
   float opacity = 1.0f;
   char const* get_type_name() const override { return "gen/composite"; }
 
   OpGenComposite() {
-    prog_id = make_fullscreen_program("shaders/gen/composite.frag");
     input_names = { "base texture", "layer texture" };
     input_ids = { -1, -1 };
+    prog_id = make_pointwise_program(pointwise_source(), 2);
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int input_w, int input_h) override {
+  void apply(const std::vector<GLuint>& input_textures) override {
     if (input_textures.size() < 2) { return; }
-    GLuint base_tex_id  = input_textures[0];
-    GLuint layer_tex_id = input_textures[1];
+    // texture 0: base, texture 1: layer
+    apply_pointwise(input_textures);
+  }
+
+  const char* pointwise_source() const override { return "shaders/gen/composite.glsl"; }
 
-    apply_input_size(input_w, input_h);
-    ensure_layer_fbo(out_w, out_h);
+  bool folds_constants() const override { return true; }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+  // mirrors blend_composite in composite.glsl
+  void fold_constant(const std::vector<const float*>& inputs, float out[4]) const override {
+    const float* base = inputs[0];
+    const float* layer = inputs[1];
+    float as = layer[3] * composite_sat(opacity);
+    float ab = base[3];
+    float ao = as + ab * (1.0f - as);
+    for (int i = 0; i < 3; i++) {
+      float mixed = composite_apply_mode(mix_type, base[i], layer[i]);
+      float co = mixed * as + base[i] * (1.0f - as);
+      out[i] = ao > 1e-5f ? co / ao : 0.0f;
+    }
+    out[3] = ao;
+  }
+
+  enum Uniform { UNIFORM_MODE, UNIFORM_OPACITY };
 
-    glUseProgram(prog_id);
-    // texture 0: base
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, base_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uBase"), 0);
-    // texture 1: layer
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, layer_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uLayer"), 1);
-    glUniform1i(glGetUniformLocation(prog_id, "uMode"), static_cast<int>(mix_type));
-    glUniform1f(glGetUniformLocation(prog_id, "uOpacity"), opacity);
+  std::vector<const char*> pointwise_uniforms() const override {
+    return { "uMode", "uOpacity" };
+  }
+
+  void set_pointwise_uniforms(const UniformSlots& u) const override {
+    gl_uniform1i(u, UNIFORM_MODE, static_cast<int>(mix_type));
+    gl_uniform1f(u, UNIFORM_OPACITY, opacity);
+  }
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  uint64_t hash_params(uint64_t h) const override {
+    h = hash_value(h, mix_type);
+    h = hash_value(h, opacity);
+    return h;
   }
 
-  void ui(int i) override {
+  bool ui(int i) override {
+    bool changed = false;
     const char *items[] = {
       "normal",
       "multiply",
@@ -65,12 +109,14 @@ struct OpGenComposite : public Op {
           items,
           IM_ARRAYSIZE(items))) {
       mix_type = static_cast<MixType>(current_mix_type);
+      changed = true;
     }
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("opacity", i),
       &opacity,
       0.0f,
       1.0f
     );
+    return changed;
   }
 };
\ No newline at end of file
@@ -11,66 +11,88 @@ struct OpGenGrade : public Op {
   char const* get_type_name() const override { return "gen/grade"; }
 
   OpGenGrade() {
-    prog_id = make_fullscreen_program("shaders/gen/grade.frag");
     input_names = { "texture" };
     input_ids = { -1 };
+    prog_id = make_pointwise_program(pointwise_source(), 1);
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int input_w, int input_h) override {
+  void apply(const std::vector<GLuint>& input_textures) override {
     if (input_textures.empty()) { return; }
-    GLuint base_tex_id = input_textures[0];
+    apply_pointwise(input_textures);
+  }
+
+  const char* pointwise_source() const override { return "shaders/gen/grade.glsl"; }
 
-    apply_input_size(input_w, input_h);
-    ensure_layer_fbo(out_w, out_h);
+  bool folds_constants() const override { return true; }
+
+  // mirrors grade.glsl
+  void fold_constant(const std::vector<const float*>& inputs, float out[4]) const override {
+    const float* src = inputs[0];
+    for (int i = 0; i < 3; i++) {
+      float col = src[i];
+      float lifted = col * (1.0f - lift) + lift;
+      float applied = std::pow(std::max(lifted, 0.0f), 1.0f / std::max(gamma, 0.0001f));
+      float graded = std::clamp(applied * gain + offset, 0.0f, 1.0f);
+      out[i] = col + (graded - col) * strength;
+    }
+    out[3] = src[3];
+  }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+  enum Uniform { UNIFORM_LIFT, UNIFORM_GAMMA, UNIFORM_GAIN, UNIFORM_OFFSET, UNIFORM_STRENGTH };
 
-    glUseProgram(prog_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, base_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uTex"), 0);
-    glUniform3f(glGetUniformLocation(prog_id, "uLift"),   lift,   lift,   lift);
-    glUniform3f(glGetUniformLocation(prog_id, "uGamma"),  gamma,  gamma,  gamma);
-    glUniform3f(glGetUniformLocation(prog_id, "uGain"),   gain,   gain,   gain);
-    glUniform3f(glGetUniformLocation(prog_id, "uOffset"), offset, offset, offset);
-    glUniform1f(glGetUniformLocation(prog_id, "uStrength"), strength);
+  std::vector<const char*> pointwise_uniforms() const override {
+    return { "uLift", "uGamma", "uGain", "uOffset", "uStrength" };
+  }
+
+  void set_pointwise_uniforms(const UniformSlots& u) const override {
+    gl_uniform3f(u, UNIFORM_LIFT,   lift,   lift,   lift);
+    gl_uniform3f(u, UNIFORM_GAMMA,  gamma,  gamma,  gamma);
+    gl_uniform3f(u, UNIFORM_GAIN,   gain,   gain,   gain);
+    gl_uniform3f(u, UNIFORM_OFFSET, offset, offset, offset);
+    gl_uniform1f(u, UNIFORM_STRENGTH, strength);
+  }
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  uint64_t hash_params(uint64_t h) const override {
+    h = hash_value(h, lift);
+    h = hash_value(h, gamma);
+    h = hash_value(h, gain);
+    h = hash_value(h, offset);
+    h = hash_value(h, strength);
+    return h;
   }
 
-  void ui(int i) override {
-    ImGui::SliderFloat(
+  bool ui(int i) override {
+    bool changed = false;
+    changed |= ImGui::SliderFloat(
       format_id("lift", i),
       &lift,
       -1.0f,
       1.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("gamma", i),
       &gamma,
       0.01f,
       3.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("gain", i),
       &gain,
       0.0f,
       4.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("offset", i),
       &offset,
       -1.0f,
       1.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("strength", i),
       &strength,
       0.0f,
       1.0f
     );
+    return changed;
   }
 };
\ No newline at end of file
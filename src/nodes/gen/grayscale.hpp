@@ -6,28 +6,25 @@ struct OpGenGrayscale : public Op {
   char const* get_type_name() const override { return "gen/grayscale"; }
 
   OpGenGrayscale() {
-    prog_id = make_fullscreen_program("shaders/gen/grayscale.frag");
     input_names = { "texture" };
     input_ids = { -1 };
+    prog_id = make_pointwise_program(pointwise_source(), 1);
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int input_w, int input_h) override {
+  void apply(const std::vector<GLuint>& input_textures) override {
     if (input_textures.empty()) { return; }
-    GLuint base_tex_id = input_textures[0];
-
-    apply_input_size(input_w, input_h);
-    ensure_layer_fbo(out_w, out_h);
+    apply_pointwise(input_textures);
+  }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+  const char* pointwise_source() const override { return "shaders/gen/grayscale.glsl"; }
 
-    glUseProgram(prog_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, base_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uTex"), 0);
+  bool folds_constants() const override { return true; }
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  // mirrors grayscale.glsl
+  void fold_constant(const std::vector<const float*>& inputs, float out[4]) const override {
+    const float* c = inputs[0];
+    float gray = c[0] * 0.299f + c[1] * 0.587f + c[2] * 0.114f;
+    out[0] = out[1] = out[2] = gray;
+    out[3] = c[3];
   }
 };
\ No newline at end of file
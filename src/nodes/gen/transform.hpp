@@ -11,32 +11,44 @@ struct OpGenTransform : public Op {
   float angle           = 0.0f;
   bool  flip_horizontal = false;
   bool  flip_vertical   = false;
+  enum Uniform { UNIFORM_TEX, UNIFORM_XFORM, UNIFORM_INPUT_XFORM, UNIFORM_INPUT_CLIP };
+  UniformSlots uniforms;
   char const* get_type_name() const override { return "gen/transform"; }
 
   OpGenTransform() {
-    prog_id = make_fullscreen_program("shaders/gen/transform.frag");
+    prog_id = get_fullscreen_program("shaders/gen/transform.frag");
     input_names = { "texture" };
     input_ids = { -1 };
   }
 
-  void apply(const std::vector<GLuint>& input_textures, int input_w, int input_h) override {
+  void apply(const std::vector<GLuint>& input_textures) override {
     GLuint base_tex_id = 0;
     if (input_textures.empty()) { return; }
     base_tex_id = input_textures[0];
 
-    apply_input_size(input_w, input_h);
-    ensure_layer_fbo(out_w, out_h);
+    check_targets();
+    if (uniforms.program != prog_id) {
+      uniforms.resolve(prog_id, "", { "uTex", "uXform", "uInputXform", "uInputClip" });
+    }
+    begin_pass(layer_fbo);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, layer_fbo.fbo_id);
-    glViewport(0, 0, out_w, out_h);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    gl_use_program(prog_id);
+    gl_active_texture(GL_TEXTURE0);
+    gl_bind_texture(GL_TEXTURE_2D, base_tex_id);
+    gl_uniform1i(uniforms, UNIFORM_TEX, 0);
 
-    glUseProgram(prog_id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, base_tex_id);
-    glUniform1i(glGetUniformLocation(prog_id, "uTex"), 0);
+    AffineMat3 M = uv_matrix();
+    gl_uniform_matrix3fv(uniforms, UNIFORM_XFORM, GL_TRUE, M.m);
+    // a deferred transform upstream is applied in the same resample
+    UVXform input_xform = input_xforms.empty() ? UVXform{} : input_xforms[0];
+    gl_uniform_matrix3fv(uniforms, UNIFORM_INPUT_XFORM, GL_TRUE, input_xform.matrix.m);
+    gl_uniform_matrix3fv(uniforms, UNIFORM_INPUT_CLIP, GL_TRUE, input_xform.clip.m);
 
+    gl_draw_fullscreen();
+  }
+
+  // maps output uv to the input uv it samples
+  AffineMat3 uv_matrix() const {
     AffineMat3 M = amat3_identity();
     ImVec2 pivot = {0.5f, 0.5f};
 
@@ -56,54 +68,86 @@ struct OpGenTransform : public Op {
       flip_vertical   ? -1.f : 1.f
     ));
     M = amat3_mul(M, amat3_transform(-pivot.x, -pivot.y));
+    return M;
+  }
+
+  bool input_uv_matrix(AffineMat3& out) const override {
+    out = uv_matrix();
+    return true;
+  }
 
-    glUniformMatrix3fv(glGetUniformLocation(prog_id, "uXform"), 1, GL_TRUE, M.m);
+  bool samples_input_xforms() const override { return true; }
+
+  // the input's window mapped to where it lands in the output
+  UVRect output_window(const std::vector<UVRect>& input_windows) const override {
+    AffineMat3 inv;
+    if (!amat3_inverse(uv_matrix(), inv)) {
+      return uvrect_empty();
+    }
+    return uvrect_clamp(uvrect_transform(inv, input_windows[0]));
+  }
+
+  UVRect input_roi(const UVRect& roi, int) const override {
+    // pad a texel for linear filtering
+    UVRect r = uvrect_transform(uv_matrix(), roi);
+    return uvrect_pad(r, 1.0f / out_w, 1.0f / out_h);
+  }
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  uint64_t hash_params(uint64_t h) const override {
+    h = hash_value(h, offset_x);
+    h = hash_value(h, offset_y);
+    h = hash_value(h, size_x);
+    h = hash_value(h, size_uniform ? size_x : size_y);
+    h = hash_value(h, angle);
+    h = hash_value(h, flip_horizontal);
+    h = hash_value(h, flip_vertical);
+    return h;
   }
 
-  void ui(int i) override {
-    ImGui::SliderFloat(
+  bool ui(int i) override {
+    bool changed = false;
+    changed |= ImGui::SliderFloat(
       format_id("offset x", i),
       &offset_x,
       -1000.0f,
       1000.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("offset y", i),
       &offset_y,
       -1000.0f,
       1000.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("size x", i),
       &size_x,
       0.01f,
       10.0f
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("size y", i),
       size_uniform ? &size_x : &size_y,
       0.01f,
       10.0f
     );
-    ImGui::Checkbox(
+    changed |= ImGui::Checkbox(
       format_id("size uniform", i),
       &size_uniform
     );
-    ImGui::SliderFloat(
+    changed |= ImGui::SliderFloat(
       format_id("angle", i),
       &angle,
       0.0f,
       360.0f
     );
-    ImGui::Checkbox(
+    changed |= ImGui::Checkbox(
       format_id("flip horizontal", i),
       &flip_horizontal
     );
-    ImGui::Checkbox(
+    changed |= ImGui::Checkbox(
       format_id("flip vertical", i),
       &flip_vertical
     );
+    return changed;
   }
 };
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include "shader.hpp"
+
+// every render target is taken from here and handed back here instead of
+// being created and deleted, so resizing a chain of ops or switching
+// between nodes reuses textures rather than stalling on allocations.
+// a texture keeps the size and format it was created with for its whole
+// life; targets of another size are other textures, kept in their own
+// bucket. idle targets are deleted once over idle_budget_bytes, oldest
+// first, or after max_idle_frames without being reused
+struct FBOPool {
+  struct Idle {
+    FBO fbo;
+    uint64_t frame; // when it was handed back
+  };
+
+  std::unordered_map<uint64_t, std::deque<Idle>> idle; // oldest first
+  size_t idle_bytes = 0;
+  size_t idle_count = 0;
+  size_t idle_budget_bytes = (size_t)256 << 20;
+  uint64_t max_idle_frames = 600;
+  uint64_t frame = 0;
+
+  // stats
+  size_t allocations = 0;
+  size_t reuses = 0;
+  size_t frees = 0;
+  size_t live_count = 0; // handed out and not back yet
+  size_t live_bytes = 0;
+  size_t peak_bytes = 0; // live and idle
+
+  // gl enums of the formats used fit in 16 bits, sizes in 24
+  static uint64_t bucket_key(int w, int h, GLenum format) {
+    return ((uint64_t)(uint32_t)w << 40) | ((uint64_t)((uint32_t)h & 0xffffff) << 16) | (format & 0xffff);
+  }
+
+  FBO acquire(int w, int h, GLenum format = GL_RGBA8) {
+    FBO fbo;
+    auto it = idle.find(bucket_key(w, h, format));
+    if (it != idle.end() && !it->second.empty()) {
+      // the most recently used one is the most likely to still be resident
+      fbo = it->second.back().fbo;
+      it->second.pop_back();
+      if (it->second.empty()) {
+        idle.erase(it);
+      }
+      idle_bytes -= fbo.size_bytes();
+      idle_count--;
+      reuses++;
+    } else {
+      // targets move between ops, so they belong to none
+      GpuResourceScope scope(GpuResources::OWNER_SHARED);
+      fbo.create(w, h, format);
+      allocations++;
+    }
+    live_count++;
+    live_bytes += fbo.size_bytes();
+    peak_bytes = std::max(peak_bytes, live_bytes + idle_bytes);
+    return fbo;
+  }
+
+  // takes ownership of fbo, which came from acquire, leaving it empty
+  void release(FBO& fbo) {
+    if (fbo.tex.id == 0) {
+      return;
+    }
+    live_count--;
+    live_bytes -= fbo.size_bytes();
+    idle_bytes += fbo.size_bytes();
+    idle_count++;
+    idle[bucket_key(fbo.tex.w, fbo.tex.h, fbo.tex.format)].push_back({ fbo, frame });
+    fbo = FBO{};
+    trim(idle_budget_bytes);
+  }
+
+  // makes sure fbo is w x h in format, swapping it for a pooled target if not
+  void ensure(FBO& fbo, int w, int h, GLenum format = GL_RGBA8) {
+    if (fbo.tex.id != 0 && fbo.tex.w == w && fbo.tex.h == h && fbo.tex.format == format) {
+      return;
+    }
+    release(fbo);
+    fbo = acquire(w, h, format);
+  }
+
+  // deletes idle targets, oldest first, until at most bytes are idle
+  void trim(size_t bytes) {
+    while (idle_bytes > bytes) {
+      auto oldest = idle.end();
+      for (auto it = idle.begin(); it != idle.end(); ++it) {
+        if (it->second.empty()) {
+          continue;
+        }
+        if (oldest == idle.end() || it->second.front().frame < oldest->second.front().frame) {
+          oldest = it;
+        }
+      }
+      if (oldest == idle.end()) {
+        return;
+      }
+      free_front(oldest);
+    }
+  }
+
+  // call once a frame, ages out targets nothing asked for in a while
+  void end_frame() {
+    frame++;
+    for (auto it = idle.begin(); it != idle.end();) {
+      while (!it->second.empty() && frame - it->second.front().frame > max_idle_frames) {
+        it = free_front(it);
+        if (it == idle.end()) {
+          return;
+        }
+      }
+      ++it;
+    }
+  }
+
+  // deletes the oldest target of a bucket, returns where iteration goes on
+  std::unordered_map<uint64_t, std::deque<Idle>>::iterator free_front(
+    std::unordered_map<uint64_t, std::deque<Idle>>::iterator it
+  ) {
+    Idle& entry = it->second.front();
+    idle_bytes -= entry.fbo.size_bytes();
+    idle_count--;
+    entry.fbo.destroy();
+    it->second.pop_front();
+    frees++;
+    return it->second.empty() ? idle.erase(it) : it;
+  }
+};
+
+static FBOPool& fbo_pool() {
+  static FBOPool pool;
+  return pool;
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "trace.hpp"
+
+// gpu time of each op's passes, measured with GL_TIME_ELAPSED queries.
+// results are read back once the gpu has them, a few frames later, so
+// timing never waits on the gpu. queries can't nest, so only one op is
+// timed at a time; a fused step is timed as its last op. while a trace is
+// recording each query also gets a timestamp, placing it on the trace's gpu
+// track (see trace.hpp)
+struct GpuTimers {
+  struct Pending {
+    GLuint query;
+    GLuint stamp; // GL_TIMESTAMP query at the start, 0 if not tracing
+    int op_id; // -1 once the op is gone
+    const char* name;
+    uint64_t frame;
+  };
+
+  struct OpTiming {
+    double last_ms = 0.0; // gpu time of the op's passes in the last frame it ran
+    double avg_ms = 0.0; // exponential moving average over the frames it ran
+    uint64_t runs = 0;
+    // summed over the frame while its queries come in, see collect
+    uint64_t frame = 0;
+    double frame_ms = 0.0;
+  };
+
+  // gpu time of everything timed in a frame, by GpuTimers::frame, as it is
+  // read back. drained by the caller, see FrameTimes::set_gpu
+  std::vector<std::pair<uint64_t, double>> finished_frames;
+
+  bool enabled = true;
+  float smoothing = 0.1f; // weight of the newest frame in avg_ms
+  std::unordered_map<int, OpTiming> timings; // by op id
+  std::deque<Pending> pending; // oldest first
+  std::vector<GLuint> free_queries;
+  std::vector<GLuint> free_stamps; // queries can't change type
+  GLuint active = 0;
+  uint64_t frame = 1; // 0 means none below
+  double frame_gpu_ms = 0.0; // all timed ops in the last frame read back
+  uint64_t sum_frame = 0;
+  double sum_ms = 0.0;
+
+  static GLuint take_query(std::vector<GLuint>& free) {
+    if (free.empty()) {
+      GLuint query = 0;
+      glGenQueries(1, &query);
+      return query;
+    }
+    GLuint query = free.back();
+    free.pop_back();
+    return query;
+  }
+
+  void begin(int op_id, const char* name) {
+    bool tracing = tracer().recording;
+    if ((!enabled && !tracing) || active != 0) {
+      return;
+    }
+    GLuint stamp = 0;
+    if (tracing) {
+      stamp = take_query(free_stamps);
+      glQueryCounter(stamp, GL_TIMESTAMP);
+    }
+    active = take_query(free_queries);
+    glBeginQuery(GL_TIME_ELAPSED, active);
+    pending.push_back({ active, stamp, op_id, name, frame });
+  }
+
+  void end() {
+    if (active == 0) {
+      return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    active = 0;
+  }
+
+  // reads back the queries that are done, in order. call once a frame
+  void collect() {
+    while (!pending.empty()) {
+      Pending& p = pending.front();
+      if (p.query == active) {
+        break;
+      }
+      GLint available = 0;
+      glGetQueryObjectiv(p.query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        break;
+      }
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(p.query, GL_QUERY_RESULT, &ns);
+      double ms = (double)ns * 1e-6;
+      if (p.op_id >= 0) {
+        add_sample(timings[p.op_id], p.frame, ms);
+      }
+      if (p.stamp != 0) {
+        // issued before the elapsed query, so it is done too
+        GLuint64 start_ns = 0;
+        glGetQueryObjectui64v(p.stamp, GL_QUERY_RESULT, &start_ns);
+        tracer().gpu_span(p.name, p.op_id, start_ns, ns);
+        free_stamps.push_back(p.stamp);
+      }
+      if (p.frame != sum_frame) {
+        publish_frame();
+        sum_frame = p.frame;
+      }
+      sum_ms += ms;
+      free_queries.push_back(p.query);
+      pending.pop_front();
+    }
+    // frames are complete once nothing older is pending
+    uint64_t done_before = pending.empty() ? frame + 1 : pending.front().frame;
+    if (sum_frame < done_before) {
+      publish_frame();
+    }
+    for (auto& [id, t] : timings) {
+      if (t.frame != 0 && t.frame < done_before) {
+        finish_frame(t);
+      }
+    }
+    frame++;
+  }
+
+  void publish_frame() {
+    if (sum_frame != 0) {
+      frame_gpu_ms = sum_ms;
+      finished_frames.push_back({ sum_frame, sum_ms });
+    }
+    sum_frame = 0;
+    sum_ms = 0.0;
+  }
+
+  // drops an op's timings, and those still in flight
+  void forget(int op_id) {
+    timings.erase(op_id);
+    for (Pending& p : pending) {
+      if (p.op_id == op_id) {
+        p.op_id = -1;
+      }
+    }
+  }
+
+  const OpTiming* get(int op_id) const {
+    auto it = timings.find(op_id);
+    return it == timings.end() || it->second.runs == 0 ? nullptr : &it->second;
+  }
+
+  // largest avg_ms of any op, for scaling highlights
+  double max_avg_ms() const {
+    double result = 0.0;
+    for (const auto& [id, t] : timings) {
+      result = std::max(result, t.avg_ms);
+    }
+    return result;
+  }
+
+  // an op runs several times a frame while refining, so samples are summed
+  // per frame before they count
+  void add_sample(OpTiming& t, uint64_t sample_frame, double ms) {
+    if (t.frame != sample_frame) {
+      finish_frame(t);
+      t.frame = sample_frame;
+    }
+    t.frame_ms += ms;
+  }
+
+  void finish_frame(OpTiming& t) {
+    if (t.frame == 0) {
+      return;
+    }
+    t.last_ms = t.frame_ms;
+    t.avg_ms = t.runs == 0 ? t.frame_ms : t.avg_ms + (t.frame_ms - t.avg_ms) * smoothing;
+    t.runs++;
+    t.frame = 0;
+    t.frame_ms = 0.0;
+  }
+};
+
+// the last few hundred frames' times, cpu split into phases, for spotting
+// stutter an average hides. gpu time is the sum of what GpuTimers timed in
+// the frame, known a few frames later
+struct FrameTimes {
+  enum Phase { PHASE_UI, PHASE_EVAL, PHASE_PRESENT, PHASE_SWAP, PHASE_COUNT };
+
+  static const char* phase_name(int phase) {
+    static const char* names[PHASE_COUNT] = { "ui", "eval", "present", "swap" };
+    return names[phase];
+  }
+
+  struct Sample {
+    uint64_t gpu_frame = 0; // GpuTimers::frame it was timed in
+    float cpu_ms = 0.0f;
+    float gpu_ms = -1.0f; // negative until read back
+    float phase_ms[PHASE_COUNT] = {};
+  };
+
+  static constexpr int CAPACITY = 600;
+  Sample samples[CAPACITY];
+  int next = 0; // where the next frame goes
+  int count = 0;
+  Sample current;
+
+  // adds the time since t0_us (see Tracer::now_us) to a phase of this frame
+  void add(Phase phase, double t0_us) {
+    current.phase_ms[phase] += (float)((Tracer::now_us() - t0_us) * 1e-3);
+  }
+
+  void end_frame(double frame_t0_us, uint64_t gpu_frame) {
+    current.cpu_ms = (float)((Tracer::now_us() - frame_t0_us) * 1e-3);
+    current.gpu_frame = gpu_frame;
+    samples[next] = current;
+    next = (next + 1) % CAPACITY;
+    count = std::min(count + 1, CAPACITY);
+    current = Sample{};
+  }
+
+  void set_gpu(uint64_t gpu_frame, double ms) {
+    for (int i = 0; i < count; i++) {
+      Sample& sample = samples[(next - 1 - i + CAPACITY) % CAPACITY];
+      if (sample.gpu_frame == gpu_frame) {
+        sample.gpu_ms = (float)ms;
+        return;
+      }
+    }
+  }
+
+  // i-th frame, oldest first
+  const Sample& at(int i) const {
+    return samples[(next - count + i + CAPACITY) % CAPACITY];
+  }
+
+  // p50/p95/p99/worst of a field over the frames that have it, false if none
+  template <typename F>
+  bool percentiles(F field, float out[4]) const {
+    std::vector<float> values;
+    values.reserve(count);
+    for (int i = 0; i < count; i++) {
+      float value = field(at(i));
+      if (value >= 0.0f) {
+        values.push_back(value);
+      }
+    }
+    if (values.empty()) {
+      return false;
+    }
+    std::sort(values.begin(), values.end());
+    const float ranks[3] = { 0.50f, 0.95f, 0.99f };
+    for (int i = 0; i < 3; i++) {
+      out[i] = values[std::min(values.size() - 1, (size_t)(ranks[i] * values.size()))];
+    }
+    out[3] = values.back();
+    return true;
+  }
+
+  bool write_csv(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+      LOG_ERROR("Failed to write frame times: %s", path);
+      return false;
+    }
+    fprintf(file, "frame,cpu_ms,gpu_ms");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      fprintf(file, ",%s_ms", phase_name(p));
+    }
+    fprintf(file, "\n");
+    for (int i = 0; i < count; i++) {
+      const Sample& sample = at(i);
+      fprintf(file, "%d,%.3f,", i, sample.cpu_ms);
+      if (sample.gpu_ms >= 0.0f) {
+        fprintf(file, "%.3f", sample.gpu_ms);
+      }
+      for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(file, ",%.3f", sample.phase_ms[p]);
+      }
+      fprintf(file, "\n");
+    }
+    fclose(file);
+    LOG_INFO("Wrote frame times: %s (%d frames)", path, count);
+    return true;
+  }
+};
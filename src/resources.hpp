@@ -0,0 +1,144 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+enum class GpuResourceKind { Texture = 0, Framebuffer, Program, Count };
+
+static const char* gpu_resource_kind_name(GpuResourceKind kind) {
+  switch (kind) {
+    case GpuResourceKind::Texture: return "texture";
+    case GpuResourceKind::Framebuffer: return "framebuffer";
+    case GpuResourceKind::Program: return "program";
+    default: return "?";
+  }
+}
+
+// every gl object the app creates, with its size and the op it belongs to,
+// so the profiler can show vram per op and point out leaks. objects are
+// owned by whatever owner is current when they are created, see
+// GpuResourceScope. an op's constructor runs before it has an id, so what
+// it creates waits as OWNER_NEW_OP until State::register_op adopts it.
+// objects are also indexed by owner, so handing them over and asking what
+// an owner has cost only what it owns
+struct GpuResources {
+  static constexpr int OWNER_SHARED = -1; // state, pools and caches
+  static constexpr int OWNER_NEW_OP = -2;
+  static constexpr int OWNER_GONE = -3; // outlived its op, see orphan
+
+  using Key = std::pair<int, GLuint>; // kind and gl name
+
+  struct Entry {
+    GpuResourceKind kind;
+    size_t bytes;
+    int owner;
+    const char* label; // static string
+  };
+
+  struct Owned {
+    std::set<Key> keys;
+    size_t bytes = 0;
+  };
+
+  std::map<Key, Entry> entries;
+  std::unordered_map<int, Owned> owners; // no entry if it owns nothing
+  int owner = OWNER_SHARED;
+
+  // stats
+  size_t count[(int)GpuResourceKind::Count] = {};
+  size_t bytes[(int)GpuResourceKind::Count] = {};
+  size_t unknown_deletes = 0; // deletes of objects never tracked
+
+  // records a new object, or the new storage of a tracked one
+  void track(GpuResourceKind kind, GLuint id, size_t size, const char* label) {
+    if (id == 0) {
+      return;
+    }
+    Key key = { (int)kind, id };
+    auto [it, added] = entries.try_emplace(key, Entry{ kind, 0, owner, label });
+    Owned& owned = owners[it->second.owner];
+    if (added) {
+      count[(int)kind]++;
+      owned.keys.insert(key);
+    }
+    bytes[(int)kind] += size - it->second.bytes;
+    owned.bytes += size - it->second.bytes;
+    it->second.bytes = size;
+    it->second.label = label;
+  }
+
+  void untrack(GpuResourceKind kind, GLuint id) {
+    if (id == 0) {
+      return;
+    }
+    auto it = entries.find({ (int)kind, id });
+    if (it == entries.end()) {
+      unknown_deletes++;
+      return;
+    }
+    count[(int)kind]--;
+    bytes[(int)kind] -= it->second.bytes;
+    auto owned = owners.find(it->second.owner);
+    owned->second.keys.erase(it->first);
+    owned->second.bytes -= it->second.bytes;
+    if (owned->second.keys.empty()) {
+      owners.erase(owned);
+    }
+    entries.erase(it);
+  }
+
+  // hands everything from_owner owns to to_owner
+  void transfer(int from_owner, int to_owner) {
+    auto from = owners.find(from_owner);
+    if (from_owner == to_owner || from == owners.end()) {
+      return;
+    }
+    Owned moved = std::move(from->second);
+    owners.erase(from);
+    Owned& to = owners[to_owner];
+    for (const Key& key : moved.keys) {
+      entries.at(key).owner = to_owner;
+      to.keys.insert(key);
+    }
+    to.bytes += moved.bytes;
+  }
+
+  // hands what the op's constructor created to its id
+  void adopt(int op_id) {
+    transfer(OWNER_NEW_OP, op_id);
+    owner = OWNER_SHARED;
+  }
+
+  // called once an op is removed; anything it still owns is a leak
+  void orphan(int op_id) {
+    transfer(op_id, OWNER_GONE);
+  }
+
+  // null if it owns nothing
+  const Owned* owned(int owner_id) const {
+    auto it = owners.find(owner_id);
+    return it == owners.end() ? nullptr : &it->second;
+  }
+
+  size_t owned_bytes(int owner_id) const {
+    const Owned* o = owned(owner_id);
+    return o ? o->bytes : 0;
+  }
+};
+
+static GpuResources& gpu_resources() {
+  static GpuResources resources;
+  return resources;
+}
+
+// makes owner the owner of the objects created while it lives
+struct GpuResourceScope {
+  int prev;
+  explicit GpuResourceScope(int owner) : prev(gpu_resources().owner) { gpu_resources().owner = owner; }
+  ~GpuResourceScope() { gpu_resources().owner = prev; }
+  GpuResourceScope(const GpuResourceScope&) = delete;
+  GpuResourceScope& operator=(const GpuResourceScope&) = delete;
+};
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <string>
+#include <unordered_map>
+#include "gl_calls.hpp"
+#include "resources.hpp"
 #include "utils.hpp"
 
 static void glCheck(bool cond, const char* msg) {
@@ -34,9 +38,10 @@ static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
     char log[1024];
     glGetProgramInfoLog(program, 1024, NULL, log);
     LOG_ERROR("Program linking error: %s", log);
-    glDeleteProgram(program);
+    gl_delete_program(program);
     return 0;
   }
+  gpu_resources().track(GpuResourceKind::Program, program, 0, "program");
   return program;
 }
 
@@ -52,69 +57,142 @@ static std::string load_source(const char* filepath) {
   return source;
 }
 
+// bytes per pixel of the internal formats render targets use
+static size_t texture_format_bytes(GLenum format) {
+  switch (format) {
+    case GL_R8: return 1;
+    case GL_RGBA16F: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4;
+  }
+}
+
 struct Texture {
   GLuint id = 0;
   int w = 0, h = 0;
-  void create_RGBA8(int W, int H, const void* pixels = nullptr){
+  GLenum format = GL_RGBA8;
+
+  // storage is specified once here and never respecified, a texture of
+  // another size or format is a new texture (see FBOPool)
+  void create(int W, int H, GLenum internal_format, const void* pixels = nullptr) {
     w = W; h = H;
+    format = internal_format;
     glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    gl_bind_texture(GL_TEXTURE_2D, id);
+    GLenum type = format == GL_RGBA16F || format == GL_RGBA32F ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    GLenum layout = format == GL_R8 ? GL_RED : GL_RGBA;
+    gl_tex_image_2d(GL_TEXTURE_2D, 0, format, w, h, 0, layout, type, pixels);
+    gpu_resources().track(GpuResourceKind::Texture, id, (size_t)w * h * texture_format_bytes(format), "texture");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   }
 
+  void create_RGBA8(int W, int H, const void* pixels = nullptr) {
+    create(W, H, GL_RGBA8, pixels);
+  }
+
   void set_filter_mode(GLenum mode) {
-    glBindTexture(GL_TEXTURE_2D, id);
+    gl_bind_texture(GL_TEXTURE_2D, id);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mode);
   }
 };
 
+// a texture with a framebuffer rendering to it. render targets come from
+// fbo_pool() rather than being created directly, see pool.hpp
 struct FBO {
   GLuint fbo_id = 0;
   Texture tex;
 
-  void create(int width, int height) {
-    if (tex.id != 0) glDeleteTextures(1, &tex.id);
-    tex.create_RGBA8(width, height);
+  void create(int width, int height, GLenum format = GL_RGBA8) {
+    if (tex.id != 0) {
+      gpu_resources().untrack(GpuResourceKind::Texture, tex.id);
+      gl_delete_texture(tex.id);
+    }
+    tex.create(width, height, format);
 
     glGenFramebuffers(1, &fbo_id);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id);
+    gpu_resources().track(GpuResourceKind::Framebuffer, fbo_id, 0, "framebuffer");
+    gl_bind_framebuffer(GL_FRAMEBUFFER, fbo_id);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex.id, 0);
     glCheck(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "FBO incomplete");
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
   }
 
-  void resize(int width, int height) {
-    if (tex.id != 0) glDeleteTextures(1, &tex.id);
-    tex.create_RGBA8(width, height);
-    if (fbo_id != 0) glDeleteFramebuffers(1, &fbo_id);
-    glGenFramebuffers(1, &fbo_id);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex.id, 0);
-    glCheck(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "FBO incomplete after resize");
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  void destroy() {
+    gpu_resources().untrack(GpuResourceKind::Texture, tex.id);
+    gpu_resources().untrack(GpuResourceKind::Framebuffer, fbo_id);
+    if (tex.id != 0) gl_delete_texture(tex.id);
+    if (fbo_id != 0) gl_delete_framebuffer(fbo_id);
+    tex = Texture{};
+    fbo_id = 0;
   }
+
+  size_t size_bytes() const { return (size_t)tex.w * tex.h * texture_format_bytes(tex.format); }
 };
 
-static GLuint make_fullscreen_program(const char* fragment_path) {
-  std::string vertex_src   = load_source("./shaders/fullscreen.vert");
-  std::string fragment_src = load_source(fragment_path);
-  GLuint vertex_shader   = compile_shader(GL_VERTEX_SHADER, vertex_src.c_str());
-  GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_src.c_str());
-  if (!vertex_shader || !fragment_shader) {
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-    LOG_ERROR("Failed to compile shaders for %s", fragment_path);
-    return 0;
-  } else {
+// every program the app draws with, compiled the first time it is asked for
+// and shared by everything asking for it after, so adding an op doesn't
+// read files or compile. programs belong to no op and live until shutdown.
+// all of them share fullscreen.vert, compiled once
+struct ProgramRegistry {
+  std::unordered_map<std::string, GLuint> programs; // see find
+  GLuint vertex_shader = 0;
+
+  // key is the fragment path, or what generated ones are generated from
+  // (see get_fused_program). 0 if not built yet
+  GLuint find(const std::string& key) const {
+    auto it = programs.find(key);
+    return it == programs.end() ? 0 : it->second;
+  }
+
+  // builds the program for key from fragment_src. name is only used for
+  // error messages. 0 if it failed to build, which is tried again next time
+  GLuint build(const std::string& key, const std::string& fragment_src, const char* name) {
+    if (vertex_shader == 0) {
+      std::string vertex_src = load_source("./shaders/fullscreen.vert");
+      vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_src.c_str());
+    }
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_src.c_str());
+    if (!vertex_shader || !fragment_shader) {
+      glDeleteShader(fragment_shader);
+      LOG_ERROR("Failed to compile shaders for %s", name);
+      return 0;
+    }
+    GpuResourceScope scope(GpuResources::OWNER_SHARED);
     GLuint program = link_program(vertex_shader, fragment_shader);
-    glDeleteShader(vertex_shader);
+    if (program == 0) {
+      // link_program deleted the program; the vertex shader is kept for
+      // the next one
+      glDeleteShader(fragment_shader);
+      return 0;
+    }
+    glDetachShader(program, vertex_shader);
     glDeleteShader(fragment_shader);
+    programs.emplace(key, program);
     return program;
   }
+
+  void destroy() {
+    for (auto& [key, program] : programs) {
+      gpu_resources().untrack(GpuResourceKind::Program, program);
+      gl_delete_program(program);
+    }
+    programs.clear();
+    glDeleteShader(vertex_shader);
+    vertex_shader = 0;
+  }
+};
+
+static ProgramRegistry& program_registry() {
+  static ProgramRegistry registry;
+  return registry;
+}
+
+static GLuint get_fullscreen_program(const char* fragment_path) {
+  GLuint program = program_registry().find(fragment_path);
+  return program ? program : program_registry().build(fragment_path, load_source(fragment_path), fragment_path);
 }
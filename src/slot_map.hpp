@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// packed generation (bits 20-30) and slot index (bits 0-19). handles fit in a
+// non-negative int, so they can be used as ids directly (imnodes takes ints),
+// and the null handle reads as -1
+using SlotHandle = uint32_t;
+constexpr SlotHandle NULL_SLOT_HANDLE = ~0u;
+constexpr uint32_t SLOT_INDEX_BITS = 20;
+constexpr uint32_t SLOT_INDEX_MASK = (1u << SLOT_INDEX_BITS) - 1;
+constexpr uint32_t SLOT_GENERATION_LIMIT = 1u << (31 - SLOT_INDEX_BITS);
+
+inline uint32_t slot_handle_index(SlotHandle handle) {
+  return handle & SLOT_INDEX_MASK;
+}
+
+inline uint32_t slot_handle_generation(SlotHandle handle) {
+  return handle >> SLOT_INDEX_BITS;
+}
+
+inline SlotHandle make_slot_handle(uint32_t index, uint32_t generation) {
+  return (generation << SLOT_INDEX_BITS) | index;
+}
+
+// generational slot map with O(1) insert, lookup and erase
+// values are kept densely packed for iteration; erasing moves the last value
+// into the hole, so iteration order is not stable across erases.
+// a slot's generation is bumped when its value is erased, so handles to
+// erased values never resolve again, even after the slot is reused. a slot
+// whose generation runs out is retired rather than reused, so that holds
+// however often it is reused. at most 2^20 slots are ever created
+template <typename T>
+struct SlotMap {
+  struct Slot {
+    uint32_t generation = 0;
+    uint32_t dense_index = 0; // index into values if occupied, else next free slot
+    bool occupied = false;
+  };
+
+  std::vector<T> values;
+  std::vector<uint32_t> value_slots; // slot index of each value
+  std::vector<Slot> slots;
+  uint32_t free_head = UINT32_MAX;
+
+  // no slot left to insert into
+  bool full() const {
+    return free_head == UINT32_MAX && slots.size() > SLOT_INDEX_MASK;
+  }
+
+  // returns NULL_SLOT_HANDLE, dropping value, if full
+  SlotHandle insert(T value) {
+    uint32_t index;
+    if (free_head != UINT32_MAX) {
+      index = free_head;
+      free_head = slots[index].dense_index;
+    } else {
+      index = (uint32_t)slots.size();
+      if (index > SLOT_INDEX_MASK) {
+        return NULL_SLOT_HANDLE;
+      }
+      slots.emplace_back();
+    }
+    Slot& slot = slots[index];
+    slot.dense_index = (uint32_t)values.size();
+    slot.occupied = true;
+    values.push_back(std::move(value));
+    value_slots.push_back(index);
+    return make_slot_handle(index, slot.generation);
+  }
+
+  T* get(SlotHandle handle) {
+    uint32_t index = slot_handle_index(handle);
+    if (index >= slots.size()) return nullptr;
+    const Slot& slot = slots[index];
+    if (!slot.occupied || slot.generation != slot_handle_generation(handle)) {
+      return nullptr;
+    }
+    return &values[slot.dense_index];
+  }
+
+  bool erase(SlotHandle handle) {
+    if (!get(handle)) return false;
+    uint32_t index = slot_handle_index(handle);
+    Slot& slot = slots[index];
+
+    // move the last value into the hole
+    uint32_t hole = slot.dense_index;
+    uint32_t last = (uint32_t)values.size() - 1;
+    if (hole != last) {
+      values[hole] = std::move(values[last]);
+      value_slots[hole] = value_slots[last];
+      slots[value_slots[hole]].dense_index = hole;
+    }
+    values.pop_back();
+    value_slots.pop_back();
+
+    slot.occupied = false;
+    if (++slot.generation < SLOT_GENERATION_LIMIT) {
+      slot.dense_index = free_head;
+      free_head = index;
+    }
+    return true;
+  }
+
+  size_t size() const { return values.size(); }
+  bool empty() const { return values.empty(); }
+  void reserve(size_t n) { values.reserve(n); value_slots.reserve(n); slots.reserve(n); }
+
+  T& operator[](size_t dense_index) { return values[dense_index]; }
+  typename std::vector<T>::iterator begin() { return values.begin(); }
+  typename std::vector<T>::iterator end() { return values.end(); }
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "utils.hpp"
+
+// records a few seconds of cpu spans, and gpu spans from GpuTimers, and
+// writes them as a chrome trace event file, which chrome://tracing and
+// ui.perfetto.dev open. spans on each track nest by time, so a scope
+// inside another shows up below it
+struct Tracer {
+  enum Track { TRACK_CPU = 1, TRACK_GPU = 2 };
+
+  struct Event {
+    const char* name; // static string
+    int track;
+    int op_id; // -1 if the span isn't an op's
+    double ts_us; // since the recording started
+    double dur_us;
+  };
+
+  bool recording = false;
+  int flush_frames = 0; // frames left to wait for gpu spans after recording
+  double record_seconds = 3.0;
+  size_t max_events = (size_t)1 << 20;
+  std::vector<Event> events;
+  std::string path;
+  double start_us = 0.0;
+  // gpu timestamps are on another clock, both were read at start
+  int64_t gpu_start_ns = 0;
+
+  static double now_us() {
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() * 1e-3;
+  }
+
+  // frames worth of gpu spans can still be in flight when recording stops
+  bool accepting_gpu() const { return recording || flush_frames > 0; }
+
+  void start() {
+    char name[64];
+    std::time_t t = std::time(nullptr);
+    std::strftime(name, sizeof(name), "trace-%Y%m%d-%H%M%S.json", std::localtime(&t));
+    path = name;
+    events.clear();
+    events.reserve(1 << 16);
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_start_ns = gpu_now;
+    start_us = now_us();
+    recording = true;
+    flush_frames = 0;
+    LOG_INFO("Recording trace for %.1f s", record_seconds);
+  }
+
+  // a cpu span from t0_us (see now_us) to now
+  void span(const char* name, double t0_us, int op_id = -1) {
+    if (recording && events.size() < max_events) {
+      events.push_back({ name, TRACK_CPU, op_id, t0_us - start_us, now_us() - t0_us });
+    }
+  }
+
+  void gpu_span(const char* name, int op_id, uint64_t start_ns, uint64_t dur_ns) {
+    if (accepting_gpu() && events.size() < max_events) {
+      double ts = (double)((int64_t)start_ns - gpu_start_ns) * 1e-3;
+      events.push_back({ name, TRACK_GPU, op_id, ts, (double)dur_ns * 1e-3 });
+    }
+  }
+
+  // call once a frame
+  void end_frame() {
+    if (recording && now_us() - start_us >= record_seconds * 1e6) {
+      recording = false;
+      flush_frames = 8;
+    } else if (flush_frames > 0 && --flush_frames == 0) {
+      write();
+    }
+  }
+
+  bool write() {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+      LOG_ERROR("Failed to write trace: %s", path.c_str());
+      return false;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"cpu\"}},\n", TRACK_CPU);
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"gpu\"}}", TRACK_GPU);
+    for (const Event& e : events) {
+      // names are op type names and literals, nothing to escape
+      fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+        e.name, e.track == TRACK_GPU ? "gpu" : "cpu", e.track, e.ts_us, e.dur_us);
+      if (e.op_id >= 0) {
+        fprintf(file, ",\"args\":{\"op\":%d}", e.op_id);
+      }
+      fprintf(file, "}");
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    LOG_INFO("Wrote trace: %s (%zu events)", path.c_str(), events.size());
+    events.clear();
+    events.shrink_to_fit();
+    return true;
+  }
+};
+
+static Tracer& tracer() {
+  static Tracer t;
+  return t;
+}
+
+// records a cpu span for the scope's lifetime
+struct TraceScope {
+  const char* name;
+  int op_id;
+  double t0;
+  explicit TraceScope(const char* name, int op_id = -1)
+    : name(name), op_id(op_id), t0(tracer().recording ? Tracer::now_us() : 0.0) {}
+  ~TraceScope() {
+    if (t0 != 0.0) {
+      tracer().span(name, t0, op_id);
+    }
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+};
@@ -3,8 +3,16 @@
 #if defined(_WIN32)
 #include <windows.h>
 #include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
 #include "imgui.h" // vec2
 
 struct AffineMat3 { float m[9]; };
@@ -61,6 +69,138 @@ static AffineMat3 amat3_rotate(float angle_deg) {
   return result;
 }
 
+static void amat3_apply(const AffineMat3 &a, float x, float y, float &out_x, float &out_y) {
+  out_x = a.m[0] * x + a.m[1] * y + a.m[2];
+  out_y = a.m[3] * x + a.m[4] * y + a.m[5];
+}
+
+// returns false if a is singular
+static bool amat3_inverse(const AffineMat3 &a, AffineMat3 &out) {
+  float det = a.m[0] * a.m[4] - a.m[1] * a.m[3];
+  if (std::fabs(det) < 1e-12f) return false;
+  float inv = 1.0f / det;
+  out = amat3_identity();
+  out.m[0] =  a.m[4] * inv;
+  out.m[1] = -a.m[1] * inv;
+  out.m[3] = -a.m[3] * inv;
+  out.m[4] =  a.m[0] * inv;
+  out.m[2] = -(out.m[0] * a.m[2] + out.m[1] * a.m[5]);
+  out.m[5] = -(out.m[3] * a.m[2] + out.m[4] * a.m[5]);
+  return true;
+}
+
+static bool amat3_is_identity(const AffineMat3 &a) {
+  AffineMat3 id = amat3_identity();
+  for (int i = 0; i < 9; i++) {
+    if (std::fabs(a.m[i] - id.m[i]) > 1e-6f) return false;
+  }
+  return true;
+}
+
+// where a texture is sampled: at matrix * uv, transparent unless both
+// matrix * uv and clip * uv lie inside the unit square. the clip keeps the
+// bounds of an intermediate transform when two are concatenated
+struct UVXform {
+  AffineMat3 matrix = amat3_identity();
+  AffineMat3 clip = amat3_identity();
+};
+
+// axis aligned rectangle in normalized [0, 1] uv space
+struct UVRect { float x0 = 0.0f, y0 = 0.0f, x1 = 1.0f, y1 = 1.0f; };
+
+static UVRect uvrect_empty() {
+  return UVRect{ 0.0f, 0.0f, 0.0f, 0.0f };
+}
+
+static bool uvrect_is_empty(const UVRect &r) {
+  return r.x1 <= r.x0 || r.y1 <= r.y0;
+}
+
+static UVRect uvrect_union(const UVRect &a, const UVRect &b) {
+  if (uvrect_is_empty(a)) return b;
+  if (uvrect_is_empty(b)) return a;
+  return UVRect{
+    std::min(a.x0, b.x0), std::min(a.y0, b.y0),
+    std::max(a.x1, b.x1), std::max(a.y1, b.y1)
+  };
+}
+
+static bool uvrect_contains(const UVRect &outer, const UVRect &inner) {
+  if (uvrect_is_empty(inner)) return true;
+  return outer.x0 <= inner.x0 && outer.y0 <= inner.y0
+      && outer.x1 >= inner.x1 && outer.y1 >= inner.y1;
+}
+
+// union of two rects, if it is itself a rect: one contains the other, or
+// they overlap or touch along a shared full edge
+static bool uvrect_merge(const UVRect &a, const UVRect &b, UVRect &out) {
+  if (uvrect_contains(a, b)) { out = a; return true; }
+  if (uvrect_contains(b, a)) { out = b; return true; }
+  bool same_x = a.x0 == b.x0 && a.x1 == b.x1;
+  bool same_y = a.y0 == b.y0 && a.y1 == b.y1;
+  bool meet_y = a.y0 <= b.y1 && b.y0 <= a.y1;
+  bool meet_x = a.x0 <= b.x1 && b.x0 <= a.x1;
+  if ((same_x && meet_y) || (same_y && meet_x)) {
+    out = uvrect_union(a, b);
+    return true;
+  }
+  return false;
+}
+
+static UVRect uvrect_clamp(const UVRect &r) {
+  UVRect result = {
+    std::clamp(r.x0, 0.0f, 1.0f), std::clamp(r.y0, 0.0f, 1.0f),
+    std::clamp(r.x1, 0.0f, 1.0f), std::clamp(r.y1, 0.0f, 1.0f)
+  };
+  return uvrect_is_empty(result) ? uvrect_empty() : result;
+}
+
+static UVRect uvrect_pad(const UVRect &r, float px, float py) {
+  if (uvrect_is_empty(r)) return r;
+  return UVRect{ r.x0 - px, r.y0 - py, r.x1 + px, r.y1 + py };
+}
+
+// bounding box of the rectangle's corners mapped through an affine matrix
+static UVRect uvrect_transform(const AffineMat3 &a, const UVRect &r) {
+  if (uvrect_is_empty(r)) return r;
+  const float xs[2] = { r.x0, r.x1 };
+  const float ys[2] = { r.y0, r.y1 };
+  UVRect result = { 1e30f, 1e30f, -1e30f, -1e30f };
+  for (float x : xs) {
+    for (float y : ys) {
+      float tx, ty;
+      amat3_apply(a, x, y, tx, ty);
+      result.x0 = std::min(result.x0, tx);
+      result.y0 = std::min(result.y0, ty);
+      result.x1 = std::max(result.x1, tx);
+      result.y1 = std::max(result.y1, ty);
+    }
+  }
+  return result;
+}
+
+// fnv-1a, used to build content hashes of op parameters and results
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+inline uint64_t hash_bytes(uint64_t h, const void* data, size_t size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+template <typename T>
+inline uint64_t hash_value(uint64_t h, const T& value) {
+  static_assert(std::is_trivially_copyable_v<T>, "hash_value needs a trivially copyable type");
+  return hash_bytes(h, &value, sizeof(T));
+}
+
+inline uint64_t hash_str(uint64_t h, const char* str) {
+  return hash_bytes(h, str, strlen(str) + 1);
+}
+
 // get memory usage in bytes
 inline size_t get_mem_usage() {
 #if defined(_WIN32)
@@ -69,11 +209,65 @@ inline size_t get_mem_usage() {
     return pmc.WorkingSetSize;
   }
   return 0;
+#elif defined(__linux__)
+  // resident pages are the second field
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (!file) {
+    return 0;
+  }
+  unsigned long size = 0, resident = 0;
+  int read = fscanf(file, "%lu %lu", &size, &resident);
+  fclose(file);
+  return read == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
 #else
   return 0; // TODO implement for other platforms
 #endif
 }
 
+// breakdown of the process' memory in bytes, zero where the platform
+// doesn't say. pss splits shared pages between the processes sharing them,
+// private counts pages only this process maps (on windows, its commit)
+struct MemStats {
+  size_t rss = 0;
+  size_t pss = 0;
+  size_t private_bytes = 0;
+  size_t swap = 0;
+};
+
+inline MemStats get_mem_stats() {
+  MemStats stats;
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+    stats.rss = pmc.WorkingSetSize;
+    stats.private_bytes = pmc.PagefileUsage;
+  }
+#elif defined(__linux__)
+  // lines like "Pss:  1234 kB", summed over all mappings
+  FILE* file = fopen("/proc/self/smaps_rollup", "r");
+  if (!file) {
+    stats.rss = get_mem_usage();
+    return stats;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char name[64];
+    unsigned long kb = 0;
+    if (sscanf(line, "%63[^:]: %lu kB", name, &kb) != 2) {
+      continue;
+    }
+    size_t bytes = (size_t)kb * 1024;
+    if (strcmp(name, "Rss") == 0) stats.rss = bytes;
+    else if (strcmp(name, "Pss") == 0) stats.pss = bytes;
+    else if (strcmp(name, "Private_Clean") == 0) stats.private_bytes += bytes;
+    else if (strcmp(name, "Private_Dirty") == 0) stats.private_bytes += bytes;
+    else if (strcmp(name, "Swap") == 0) stats.swap = bytes;
+  }
+  fclose(file);
+#endif
+  return stats;
+}
+
 inline std::string format_bytes(size_t bytes) {
   const char* suffixes[] = { "B", "KB", "MB", "GB", "TB" };
   size_t s = 0;